@@ -0,0 +1,161 @@
+#include "fdly_html.hpp"
+
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Build an entry body resembling a blog post summary of roughly the given size.
+ */
+string makeBody(size_t size, mt19937& rng)
+{
+    static const vector<string> words = {
+        "feed", "the", "design", "of", "a", "new", "library", "for", "reading", "news",
+        "with", "fast", "parsing", "and", "clean", "interfaces", "we", "describe", "how", "it"
+    };
+    static const vector<string> inlines = {
+        "<a href=\"https://example.com/some/long/path?with=query&amp;more=1\">", "<b>", "<em>", "<strong>"
+    };
+    static const vector<string> closes = {"</a>", "</b>", "</em>", "</strong>"};
+
+    string body = "<div class=\"content\"><script type=\"text/javascript\">var x = '<p>';</script>\n";
+    while (body.size() < size) {
+        body += "<p>";
+        for (int w = 0; w < 60; w++) {
+            size_t pick = rng() % 40;
+            if (pick < inlines.size()) {
+                body += inlines[pick] + words[rng() % words.size()] + closes[pick];
+            } else if (pick == 10) {
+                body += "&amp;";
+            } else if (pick == 11) {
+                body += "&#8217;";
+            } else {
+                body += words[pick % words.size()];
+            }
+            body += ' ';
+        }
+        body += "</p>\n<img src=\"https://example.com/image.jpg\" width=\"600\" height=\"400\" />\n";
+    }
+    body += "</div>";
+    return body;
+}
+
+/**
+ * Baseline written the obvious way: strip the tags with std::string::find,
+ * then collapse the whitespace in a second pass. References are left as
+ * written, so the text is close to, not the same as, HtmlText::Extract's.
+ */
+string naiveExtract(const string& html)
+{
+    string stripped;
+    size_t pos = 0;
+    while (pos < html.size()) {
+        size_t open = html.find('<', pos);
+        if (open == string::npos) {
+            stripped.append(html, pos, string::npos);
+            break;
+        }
+        stripped.append(html, pos, open - pos);
+
+        size_t close = html.find('>', open);
+        for (const string raw : {"script", "style"}) {
+            if (close != string::npos && html.compare(open + 1, raw.size(), raw) == 0) {
+                close = html.find("</" + raw, close);
+                close = close == string::npos ? close : html.find('>', close);
+            }
+        }
+        if (close == string::npos) {
+            break;
+        }
+        stripped += ' ';
+        pos = close + 1;
+    }
+
+    string text;
+    for (char c : stripped) {
+        if (not isspace(static_cast<unsigned char>(c))) {
+            text += c;
+        } else if (not text.empty() && text.back() != ' ') {
+            text += ' ';
+        }
+    }
+    if (not text.empty() && text.back() == ' ') {
+        text.pop_back();
+    }
+    return text;
+}
+
+template<class F>
+double measure(const vector<string>& bodies, int iterations, F extract, size_t& outputBytes)
+{
+    auto start = chrono::steady_clock::now();
+    outputBytes = 0;
+    for (int i = 0; i < iterations; i++) {
+        for (const auto& body : bodies) {
+            outputBytes += extract(body).size();
+        }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 200;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0) {
+            i++;
+            if (i < argc) {
+                iterations = atoi(argv[i]);
+            }
+        }
+    }
+
+    mt19937 rng(42);
+    const size_t sizes[] = {2 * 1024, 16 * 1024, 64 * 1024};
+
+    cout << "size      naive MB/s   scalar MB/s   simd MB/s   simd/naive   simd/scalar" << endl;
+    for (size_t size : sizes) {
+        vector<string> bodies;
+        size_t total = 0;
+        for (int i = 0; i < 32; i++) {
+            bodies.push_back(makeBody(size, rng));
+            total += bodies.back().size();
+        }
+
+        // Both scans must produce the same text
+        for (const auto& body : bodies) {
+            if (HtmlText::Extract(body) != HtmlText::ExtractScalar(body)) {
+                cerr << "Scalar and SIMD output differ for a " << size / 1024 << " KiB body" << endl;
+                return 1;
+            }
+        }
+
+        size_t naiveBytes = 0;
+        size_t scalarBytes = 0;
+        size_t simdBytes = 0;
+        double naive = measure(bodies, iterations, naiveExtract, naiveBytes);
+        double scalar = measure(bodies, iterations, HtmlText::ExtractScalar, scalarBytes);
+        double simd = measure(bodies, iterations, HtmlText::Extract, simdBytes);
+
+        double megabytes = static_cast<double>(total) * iterations / (1024 * 1024);
+        cout << size / 1024 << " KiB\t"
+             << megabytes / naive << "\t"
+             << megabytes / scalar << "\t"
+             << megabytes / simd << "\t"
+             << naive / simd << "x\t"
+             << scalar / simd << "x" << endl;
+
+        if (naiveBytes == 0 || scalarBytes == 0 || scalarBytes != simdBytes) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,246 @@
+#include "fdly.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Writes through a large buffer so that the output is not flushed per line.
+ * Call Flush() once done.
+ */
+class BufferedWriter {
+    public:
+        BufferedWriter(FILE* out, size_t capacity = 1 << 20) :
+            m_out(out),
+            m_capacity(capacity),
+            m_written(0)
+        {
+            m_buffer.reserve(m_capacity);
+        }
+
+        void Write(const string& data)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            if (m_buffer.size() + data.size() > m_capacity) {
+                FlushLocked();
+            }
+            if (data.size() >= m_capacity) {
+                WriteOut(data.data(), data.size());
+            } else {
+                m_buffer += data;
+            }
+        }
+
+        void Flush()
+        {
+            lock_guard<mutex> lock(m_mutex);
+            FlushLocked();
+            fflush(m_out);
+        }
+
+        unsigned long long Written() const
+        {
+            lock_guard<mutex> lock(m_mutex);
+            return m_written + m_buffer.size();
+        }
+
+    private:
+        void FlushLocked()
+        {
+            WriteOut(m_buffer.data(), m_buffer.size());
+            m_buffer.clear();
+        }
+
+        void WriteOut(const char* data, size_t size)
+        {
+            if (size > 0 && fwrite(data, 1, size, m_out) != size) {
+                throw runtime_error(string("Could not write output: ") + strerror(errno));
+            }
+            m_written += size;
+        }
+
+        FILE* m_out;
+        size_t m_capacity;
+        string m_buffer;
+        unsigned long long m_written;
+        mutable mutex m_mutex;
+};
+
+void print_usage()
+{
+    cout << "Exports every entry once, under the first stream it is found in" << endl;
+    cout << "Usage:" << endl;
+    cout << "   --api-key <API Key>" << endl;
+    cout << "   --user-id <User ID>" << endl;
+    cout << "   [--output <file>]       write to a file instead of stdout" << endl;
+    cout << "   [--jobs <count>]        streams fetched concurrently (default 4)" << endl;
+    cout << "   [--page-size <count>]   entries per request (default 500)" << endl;
+    cout << "   [--unread-only]         export only unread entries" << endl;
+}
+
+void append_line(string& out, const string& stream, const Fdly::Entry& entry)
+{
+    json j;
+    j["id"] = entry.ID;
+    j["stream"] = stream;
+    j["title"] = entry.Title;
+    j["originId"] = entry.OriginURL.str();
+    j["originTitle"] = entry.OriginTitle.str();
+    j["published"] = entry.Published;
+    j["crawled"] = entry.Crawled;
+    j["content"] = entry.Content;
+
+    out += j.dump();
+    out += '\n';
+}
+
+int main (int argc, char** argv)
+{
+    string apiKey;
+    string userID;
+    string output;
+    unsigned int jobs = 4;
+    unsigned int pageSize = 500;
+    bool unreadOnly = false;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--api-key" ) == 0) {
+            i++;
+            if (i < argc) {
+                apiKey = argv[i];
+            }
+        } else if (strcmp(argv[i], "--user-id") == 0) {
+            i++;
+            if (i < argc) {
+                userID = argv[i];
+            }
+        } else if (strcmp(argv[i], "--output") == 0) {
+            i++;
+            if (i < argc) {
+                output = argv[i];
+            }
+        } else if (strcmp(argv[i], "--jobs") == 0) {
+            i++;
+            if (i < argc) {
+                jobs = max(1, atoi(argv[i]));
+            }
+        } else if (strcmp(argv[i], "--page-size") == 0) {
+            i++;
+            if (i < argc) {
+                pageSize = max(1, atoi(argv[i]));
+            }
+        } else if (strcmp(argv[i], "--unread-only") == 0) {
+            unreadOnly = true;
+        }
+    }
+
+    if (userID.empty() || apiKey.empty()) {
+        print_usage();
+        return 1;
+    }
+
+    FILE* out = stdout;
+    if (not output.empty()) {
+        out = fopen(output.c_str(), "wb");
+        if (out == nullptr) {
+            cerr << "Could not open " << output << ": " << strerror(errno) << endl;
+            return 1;
+        }
+    }
+
+    Fdly::User user {userID, apiKey};
+    Fdly fdly {user};
+
+    auto start = chrono::steady_clock::now();
+
+    vector<string> streams;
+    for (const auto& ctg : fdly.GetCategories()) {
+        streams.push_back(ctg.ID.str());
+    }
+    streams.push_back("Uncategorized");
+    streams.push_back("Saved");
+
+    BufferedWriter writer(out);
+    atomic<size_t> nextStream(0);
+    atomic<unsigned long long> exported(0);
+    atomic<bool> failed(false);
+
+    // An entry shows up in every category of its feed and again in "Saved"
+    mutex seenMutex;
+    unordered_set<string> seen;
+
+    // Each worker pages through whole streams, so the requests of different
+    // streams overlap while those of one stream follow their continuations
+    auto work = [&] () {
+        string lines;
+        vector<bool> unseen;
+        for (size_t i = nextStream++; i < streams.size() && not failed; i = nextStream++) {
+            string continuation;
+            do {
+                Fdly::Entries entries;
+                try {
+                    entries = fdly.GetEntries(streams[i], true, pageSize, unreadOnly, continuation);
+                    unseen.clear();
+                    {
+                        lock_guard<mutex> lock(seenMutex);
+                        for (const auto& entry : entries) {
+                            unseen.push_back(seen.insert(entry.ID).second);
+                        }
+                    }
+
+                    lines.clear();
+                    size_t n = 0;
+                    for (const auto& entry : entries) {
+                        if (unseen[n++]) {
+                            append_line(lines, streams[i], entry);
+                            exported++;
+                        }
+                    }
+                    writer.Write(lines);
+                } catch (const exception& e) {
+                    cerr << "Export of " << streams[i] << " failed: " << e.what() << endl;
+                    failed = true;
+                    return;
+                }
+
+                continuation = entries.continuation();
+            } while (not continuation.empty());
+        }
+    };
+
+    vector<thread> workers;
+    for (unsigned int i = 0; i < jobs; i++) {
+        workers.emplace_back(work);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    try {
+        writer.Flush();
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        failed = true;
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    unsigned long long bytes = writer.Written();
+    cerr << "Exported " << exported << " entries from " << streams.size() << " streams, "
+         << bytes << " bytes in " << seconds << " s ("
+         << exported / seconds << " entries/s, "
+         << bytes / seconds << " bytes/s)" << endl;
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,669 @@
+/**
+ * Long running mix of API calls against a loopback stand-in for the Feedly
+ * API, watching the process for resource and latency drift.
+ *
+ * The stand-in runs in a child process so that its own memory, sockets and
+ * allocations stay out of the measurements.
+ */
+#include "fdly.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+using namespace std;
+
+static atomic<long long> g_allocations(0);
+static atomic<long long> g_liveAllocations(0);
+
+void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, memory_order_relaxed);
+    g_liveAllocations.fetch_add(1, memory_order_relaxed);
+
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+// GCC cannot tell that free() matches the replaced operator new once these
+// are inlined into the standard containers
+#if defined(__GNUC__) && __GNUC__ >= 11 && not defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept
+{
+    if (p != nullptr) {
+        g_liveAllocations.fetch_sub(1, memory_order_relaxed);
+        free(p);
+    }
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+struct Settings {
+    double duration = 3600;
+    double interval = 10;
+    double warmUp = 30;
+    unsigned int threads = 4;
+    double maxRssGrowthMB = 16;
+    long long maxLiveGrowth = 20000;
+    double maxAllocGrowth = 1.5;
+    int maxSocketGrowth = 2;
+    double maxLatencyGrowth = 3;
+};
+
+/**
+ * Minimal HTTP/1.1 server answering the requests Fdly makes, with keep-alive.
+ */
+class StandInServer {
+    public:
+        static const int Categories = 8;
+        static const int Feeds = 40;
+        static const int PagesPerStream = 5;
+
+        StandInServer()
+        {
+            int listener = socket(AF_INET, SOCK_STREAM, 0);
+            int yes = 1;
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+            sockaddr_in addr {};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = 0;
+            if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+                    listen(listener, 64) != 0) {
+                throw runtime_error(string("Could not start the stand-in server: ") + strerror(errno));
+            }
+
+            socklen_t length = sizeof(addr);
+            getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &length);
+            m_port = ntohs(addr.sin_port);
+
+            // Fork before any thread exists in this process
+            pid_t parent = getpid();
+            m_child = fork();
+            if (m_child < 0) {
+                throw runtime_error(string("Could not fork the stand-in server: ") + strerror(errno));
+            }
+            if (m_child == 0) {
+#ifdef __linux__
+                // Do not outlive a parent killed before it could stop us;
+                // it may have died before the request took effect
+                prctl(PR_SET_PDEATHSIG, SIGTERM);
+                if (getppid() != parent) {
+                    _exit(0);
+                }
+#else
+                (void)parent;
+#endif
+                Serve(listener);
+                _exit(0);
+            }
+            close(listener);
+        }
+
+        ~StandInServer()
+        {
+            kill(m_child, SIGTERM);
+            waitpid(m_child, nullptr, 0);
+        }
+
+        string BaseUrl() const
+        {
+            return "http://127.0.0.1:" + to_string(m_port);
+        }
+
+    private:
+        static void Serve(int listener)
+        {
+            vector<pollfd> fds {{listener, POLLIN, 0}};
+            map<int, string> input;
+
+            while (true) {
+                if (poll(fds.data(), fds.size(), -1) < 0) {
+                    continue;
+                }
+
+                for (size_t i = 1; i < fds.size(); i++) {
+                    if (fds[i].revents == 0) {
+                        continue;
+                    }
+
+                    char buffer[16384];
+                    ssize_t n = recv(fds[i].fd, buffer, sizeof(buffer), 0);
+                    if (n <= 0) {
+                        close(fds[i].fd);
+                        input.erase(fds[i].fd);
+                        fds[i].fd = -1;
+                        continue;
+                    }
+
+                    string& pending = input[fds[i].fd];
+                    pending.append(buffer, n);
+                    while (HandleRequest(fds[i].fd, pending)) {
+                    }
+                }
+
+                fds.erase(remove_if(fds.begin() + 1, fds.end(), [] (const pollfd& p) { return p.fd < 0; }), fds.end());
+
+                if (fds[0].revents & POLLIN) {
+                    int client = accept(listener, nullptr, nullptr);
+                    if (client >= 0) {
+                        fds.push_back({client, POLLIN, 0});
+                    }
+                }
+            }
+        }
+
+        /**
+         * Answer the first request in pending if it is complete and remove it.
+         */
+        static bool HandleRequest(int fd, string& pending)
+        {
+            auto headersEnd = pending.find("\r\n\r\n");
+            if (headersEnd == string::npos) {
+                return false;
+            }
+
+            size_t bodyLength = 0;
+            string headers = pending.substr(0, headersEnd);
+            string lower = headers;
+            transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+            auto contentLength = lower.find("content-length:");
+            if (contentLength != string::npos) {
+                bodyLength = strtoul(headers.c_str() + contentLength + 15, nullptr, 10);
+            }
+            if (pending.size() < headersEnd + 4 + bodyLength) {
+                return false;
+            }
+
+            istringstream requestLine(headers);
+            string method;
+            string target;
+            requestLine >> method >> target;
+            pending.erase(0, headersEnd + 4 + bodyLength);
+
+            int status = 200;
+            string body = Respond(method, target, status);
+            string response = "HTTP/1.1 " + to_string(status) + (status == 200 ? " OK" : " Not Found") +
+                "\r\nContent-Type: application/json\r\nContent-Length: " + to_string(body.size()) + "\r\n\r\n" + body;
+
+            size_t sent = 0;
+            while (sent < response.size()) {
+                ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    break;
+                }
+                sent += n;
+            }
+            return true;
+        }
+
+        static string Parameter(const string& target, const string& name)
+        {
+            auto begin = target.find(name + "=");
+            if (begin == string::npos) {
+                return "";
+            }
+            begin += name.size() + 1;
+            return target.substr(begin, target.find('&', begin) - begin);
+        }
+
+        static string Respond(const string& method, const string& target, int& status)
+        {
+            string path = target.substr(0, target.find('?'));
+
+            if (method == "POST" && path == "/v3/markers") {
+                return "";
+            }
+
+            if (path == "/v3/profile") {
+                return "{\"id\":\"soak\"}";
+            }
+
+            if (path == "/v3/categories") {
+                json j = json::array();
+                for (int i = 0; i < Categories; i++) {
+                    j.push_back({{"id", "user/soak/category/c" + to_string(i)}, {"label", "Category " + to_string(i)}});
+                }
+                return j.dump();
+            }
+
+            if (path == "/v3/subscriptions") {
+                json j = json::array();
+                for (int i = 0; i < Feeds; i++) {
+                    j.push_back({
+                        {"id", "feed/http://example.com/" + to_string(i) + "/rss"},
+                        {"title", "Feed " + to_string(i)},
+                        {"website", "http://example.com/" + to_string(i)},
+                        {"visualUrl", "http://example.com/" + to_string(i) + "/logo.png"},
+                        {"updated", 1500000000000LL + i},
+                        {"added", 1400000000000LL + i},
+                        {"categories", {{{"id", "user/soak/category/c" + to_string(i % Categories)},
+                                         {"label", "Category " + to_string(i % Categories)}}}}
+                    });
+                }
+                return j.dump();
+            }
+
+            if (path == "/v3/streams/contents") {
+                string continuation = Parameter(target, "continuation");
+                int page = continuation.empty() ? 0 : atoi(continuation.c_str() + 1);
+                int count = min(100, max(1, atoi(Parameter(target, "count").c_str())));
+                string stream = Parameter(target, "streamId");
+
+                json items = json::array();
+                for (int i = 0; i < count; i++) {
+                    int feed = (page * count + i) % Feeds;
+                    items.push_back({
+                        {"id", stream + "_" + to_string(page) + "_" + to_string(i)},
+                        {"title", "Entry " + to_string(i) + " of page " + to_string(page)},
+                        {"originId", "http://example.com/" + to_string(feed) + "/" + to_string(i)},
+                        {"summary", {{"content", "<p>" + string(500, 'x') + "</p>"}}},
+                        {"origin", {{"title", "Feed " + to_string(feed)}, {"htmlUrl", "http://example.com/" + to_string(feed)}}},
+                        {"published", 1500000000000LL + i},
+                        {"crawled", 1500000001000LL + i}
+                    });
+                }
+
+                json j {{"id", stream}, {"items", items}};
+                if (page + 1 < PagesPerStream) {
+                    j["continuation"] = "p" + to_string(page + 1);
+                }
+                return j.dump();
+            }
+
+            status = 404;
+            return "";
+        }
+
+        pid_t m_child;
+        int m_port;
+};
+
+static long long rssBytes()
+{
+    long long pages = 0;
+    long long resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm != nullptr) {
+        if (fscanf(statm, "%lld %lld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(statm);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static int openSockets()
+{
+    int sockets = 0;
+    DIR* dir = opendir("/proc/self/fd");
+    if (dir == nullptr) {
+        return -1;
+    }
+
+    while (dirent* entry = readdir(dir)) {
+        char link[64];
+        string path = string("/proc/self/fd/") + entry->d_name;
+        ssize_t n = readlink(path.c_str(), link, sizeof(link) - 1);
+        if (n > 0 && strncmp(link, "socket:", 7) == 0) {
+            sockets++;
+        }
+    }
+    closedir(dir);
+    return sockets;
+}
+
+/**
+ * Latencies of the operations completed during the current interval.
+ */
+class LatencyWindow {
+    public:
+        void Record(double ms)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_samples.push_back(ms);
+        }
+
+        vector<double> Take()
+        {
+            vector<double> samples;
+            lock_guard<mutex> lock(m_mutex);
+            samples.swap(m_samples);
+            return samples;
+        }
+
+    private:
+        mutex m_mutex;
+        vector<double> m_samples;
+};
+
+static double percentile(vector<double>& samples, double p)
+{
+    if (samples.empty()) {
+        return 0;
+    }
+    size_t index = min(samples.size() - 1, static_cast<size_t>(p * samples.size()));
+    nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+struct Sample {
+    double seconds;
+    long long operations;
+    long long rss;
+    long long liveAllocations;
+    double allocationsPerOperation;
+    int sockets;
+    double p50;
+    double p99;
+};
+
+using Metric = double (*)(const Sample&);
+
+/**
+ * Mean of a metric over samples [begin, end).
+ */
+static double average(const vector<Sample>& samples, size_t begin, size_t end, Metric metric)
+{
+    double sum = 0;
+    for (size_t i = begin; i < end; i++) {
+        sum += metric(samples[i]);
+    }
+    return end > begin ? sum / (end - begin) : 0;
+}
+
+/**
+ * Growth of a metric over the samples according to its least squares
+ * trend, so that a steady leak shows while noise in single samples does not.
+ */
+static double trendGrowth(const vector<Sample>& samples, Metric metric)
+{
+    if (samples.size() < 2) {
+        return 0;
+    }
+
+    double meanTime = average(samples, 0, samples.size(), [] (const Sample& s) { return s.seconds; });
+    double meanValue = average(samples, 0, samples.size(), metric);
+    double covariance = 0;
+    double variance = 0;
+    for (const auto& sample : samples) {
+        covariance += (sample.seconds - meanTime) * (metric(sample) - meanValue);
+        variance += (sample.seconds - meanTime) * (sample.seconds - meanTime);
+    }
+    if (variance == 0) {
+        return 0;
+    }
+    return covariance / variance * (samples.back().seconds - samples.front().seconds);
+}
+
+static void runWorkload(Fdly& fdly, LatencyWindow& latencies, atomic<long long>& operations,
+                        atomic<long long>& failures, const atomic<bool>& stopping, unsigned int seed)
+{
+    mt19937 random(seed);
+
+    auto timed = [&] (const function<void()>& call) {
+        auto start = chrono::steady_clock::now();
+        try {
+            call();
+        } catch (const exception& e) {
+            if (failures++ < 10) {
+                cerr << "Request failed: " << e.what() << endl;
+            }
+        }
+        latencies.Record(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+        operations++;
+    };
+
+    vector<string> lastIds;
+    while (not stopping) {
+        unsigned int op = random() % 10;
+        string category = "user/soak/category/c" + to_string(random() % StandInServer::Categories);
+
+        if (op < 2) {
+            timed([&] { fdly.GetCategories(); });
+        } else if (op < 3) {
+            timed([&] { fdly.GetSubscriptions(); });
+        } else if (op < 8) {
+            string continuation;
+            do {
+                timed([&] {
+                    auto entries = fdly.GetEntries(category, false, 50, true, continuation);
+                    continuation = entries.continuation();
+                    lastIds.clear();
+                    for (const auto& entry : entries) {
+                        if (lastIds.size() < 5) {
+                            lastIds.push_back(entry.ID);
+                        }
+                    }
+                });
+            } while (not continuation.empty() && not stopping);
+        } else if (op < 9) {
+            timed([&] { fdly.MarkEntriesWithAction(lastIds, Fdly::Entry::Action::READ); });
+        } else {
+            timed([&] { fdly.MarkCategoryAs(category, Fdly::Category::Action::READ); });
+        }
+    }
+}
+
+static void printUsage()
+{
+    cout << "Usage:" << endl;
+    cout << "   [--duration <s>]           length of the run (default 3600)" << endl;
+    cout << "   [--interval <s>]           time between samples (default 10)" << endl;
+    cout << "   [--warm-up <s>]            time before drift is measured (default 30)" << endl;
+    cout << "   [--threads <count>]        concurrent clients (default 4)" << endl;
+    cout << "   [--max-rss-growth <MB>]    allowed RSS growth (default 16)" << endl;
+    cout << "   [--max-live-growth <n>]    allowed growth of live allocations (default 20000)" << endl;
+    cout << "   [--max-alloc-growth <x>]   allowed growth factor of allocations per call (default 1.5)" << endl;
+    cout << "   [--max-socket-growth <n>]  allowed growth of open sockets (default 2)" << endl;
+    cout << "   [--max-latency-growth <x>] allowed growth factor of the p99 latency (default 3)" << endl;
+}
+
+int main(int argc, char** argv)
+{
+    Settings settings;
+    for (int i = 1; i < argc; i++) {
+        auto value = [&] () {
+            if (i + 1 >= argc) {
+                printUsage();
+                exit(2);
+            }
+            return atof(argv[++i]);
+        };
+
+        if (strcmp(argv[i], "--duration") == 0) {
+            settings.duration = value();
+        } else if (strcmp(argv[i], "--interval") == 0) {
+            settings.interval = value();
+        } else if (strcmp(argv[i], "--warm-up") == 0) {
+            settings.warmUp = value();
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            settings.threads = max(1, static_cast<int>(value()));
+        } else if (strcmp(argv[i], "--max-rss-growth") == 0) {
+            settings.maxRssGrowthMB = value();
+        } else if (strcmp(argv[i], "--max-live-growth") == 0) {
+            settings.maxLiveGrowth = static_cast<long long>(value());
+        } else if (strcmp(argv[i], "--max-alloc-growth") == 0) {
+            settings.maxAllocGrowth = value();
+        } else if (strcmp(argv[i], "--max-socket-growth") == 0) {
+            settings.maxSocketGrowth = static_cast<int>(value());
+        } else if (strcmp(argv[i], "--max-latency-growth") == 0) {
+            settings.maxLatencyGrowth = value();
+        } else {
+            printUsage();
+            return 2;
+        }
+    }
+    settings.warmUp = min(settings.warmUp, settings.duration / 2);
+
+    StandInServer server;
+
+    Fdly::User user {"soak", "soak-token"};
+    Fdly::Options options;
+    options.BaseUrl = server.BaseUrl();
+    Fdly fdly(user, options);
+
+    if (not fdly.CanAuthenticate()) {
+        cerr << "Could not reach the stand-in server at " << server.BaseUrl() << endl;
+        return 1;
+    }
+
+    LatencyWindow latencies;
+    atomic<long long> operations(0);
+    atomic<long long> failures(0);
+    atomic<bool> stopping(false);
+
+    vector<thread> workers;
+    for (unsigned int i = 0; i < settings.threads; i++) {
+        workers.emplace_back(runWorkload, ref(fdly), ref(latencies), ref(operations), ref(failures), cref(stopping), i + 1);
+    }
+
+    printf("%8s %10s %9s %9s %12s %10s %8s %9s %9s\n",
+           "time(s)", "calls", "calls/s", "rss(MB)", "live allocs", "allocs/op", "sockets", "p50(ms)", "p99(ms)");
+
+    auto start = chrono::steady_clock::now();
+    vector<Sample> samples;
+    bool haveBaseline = false;
+    size_t baseline = 0;
+    long long lastOperations = 0;
+    long long lastAllocations = g_allocations;
+    double lastSeconds = 0;
+
+    while (true) {
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double next = min(settings.duration, lastSeconds + settings.interval);
+        if (not haveBaseline && settings.warmUp > lastSeconds && settings.warmUp < next) {
+            next = settings.warmUp;
+        }
+        if (next > elapsed) {
+            this_thread::sleep_for(chrono::duration<double>(next - elapsed));
+        }
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        auto window = latencies.Take();
+        long long ops = operations;
+        long long allocations = g_allocations;
+        long long windowOps = max(1LL, ops - lastOperations);
+
+        Sample sample {
+            seconds,
+            ops,
+            rssBytes(),
+            g_liveAllocations.load(),
+            static_cast<double>(allocations - lastAllocations) / windowOps,
+            openSockets(),
+            percentile(window, 0.5),
+            percentile(window, 0.99)
+        };
+        samples.push_back(sample);
+
+        printf("%8.0f %10lld %9.0f %9.1f %12lld %10.0f %8d %9.2f %9.2f\n",
+               sample.seconds, sample.operations, (ops - lastOperations) / (seconds - lastSeconds),
+               sample.rss / 1048576.0, sample.liveAllocations, sample.allocationsPerOperation,
+               sample.sockets, sample.p50, sample.p99);
+        fflush(stdout);
+
+        if (not haveBaseline && seconds >= settings.warmUp) {
+            baseline = samples.size() - 1;
+            haveBaseline = true;
+        }
+
+        lastOperations = ops;
+        lastAllocations = allocations;
+        lastSeconds = seconds;
+        if (seconds >= settings.duration) {
+            break;
+        }
+    }
+
+    stopping = true;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // Leaks are judged on the trend of the samples taken after the warm-up,
+    // levels on the average of their last quarter against their first
+    vector<Sample> measured(samples.begin() + baseline, samples.end());
+    size_t window = max<size_t>(1, measured.size() / 4);
+    auto before = [&] (Metric metric) { return average(measured, 0, window, metric); };
+    auto after = [&] (Metric metric) { return average(measured, measured.size() - window, measured.size(), metric); };
+
+    Metric rss = [] (const Sample& s) { return s.rss / 1048576.0; };
+    Metric live = [] (const Sample& s) { return static_cast<double>(s.liveAllocations); };
+    Metric sockets = [] (const Sample& s) { return static_cast<double>(s.sockets); };
+    Metric allocationsPerOperation = [] (const Sample& s) { return s.allocationsPerOperation; };
+    Metric p99 = [] (const Sample& s) { return s.p99; };
+
+    const Sample& last = samples.back();
+    vector<string> drift;
+
+    double rssGrowthMB = trendGrowth(measured, rss);
+    if (rssGrowthMB > settings.maxRssGrowthMB) {
+        drift.push_back("RSS grew by " + to_string(rssGrowthMB) + " MB");
+    }
+    double liveGrowth = trendGrowth(measured, live);
+    if (liveGrowth > settings.maxLiveGrowth) {
+        drift.push_back("live allocations grew by " + to_string(liveGrowth));
+    }
+    double socketGrowth = trendGrowth(measured, sockets);
+    if (socketGrowth > settings.maxSocketGrowth) {
+        drift.push_back("open sockets grew by " + to_string(socketGrowth));
+    }
+    if (after(allocationsPerOperation) > settings.maxAllocGrowth * max(1.0, before(allocationsPerOperation))) {
+        drift.push_back("allocations per call went from " + to_string(before(allocationsPerOperation)) +
+                        " to " + to_string(after(allocationsPerOperation)));
+    }
+    // A 1 ms floor keeps scheduling noise on very fast loopback calls from
+    // failing the run
+    if (after(p99) > settings.maxLatencyGrowth * max(1.0, before(p99))) {
+        drift.push_back("p99 latency went from " + to_string(before(p99)) + " ms to " + to_string(after(p99)) + " ms");
+    }
+    if (failures > 0) {
+        drift.push_back(to_string(failures.load()) + " calls failed");
+    }
+
+    if (not drift.empty()) {
+        for (const auto& problem : drift) {
+            cerr << "FAILED: " << problem << endl;
+        }
+        return 1;
+    }
+
+    cout << "Soak test passed after " << last.seconds << " s and " << last.operations << " calls" << endl;
+    return 0;
+}
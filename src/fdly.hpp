@@ -9,15 +9,50 @@
 #include <json.hpp>
 #include <cpr/cpr.h>
 
+#include "fdly_html.hpp"
+
+#include <zlib.h>
+#ifdef FDLY_WITH_BROTLI
+#include <brotli/decode.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
 #include <stdexcept>
 #include <string>
 #include <set>
+#include <shared_mutex>
+#include <unordered_map>
 #include <vector>
 
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define FDLY_HAS_PMR 1
+#endif
+#endif
+
 using json = nlohmann::json;
 
 /**
  * @class Interface with the Feedly API
+ *
+ * A connection owns its session pool, caches and transfer counters, several
+ * of which are atomics or guarded by mutexes, so it can be neither copied nor
+ * moved. Share it by reference or hold it through a smart pointer.
  */
 class Fdly {
     public:
@@ -26,6 +61,331 @@ class Fdly {
             std::string AuthToken;
         };
 
+#ifdef FDLY_HAS_PMR
+        /**
+         * Memory resource the containers returned by the API allocate from.
+         *
+         * Only container storage comes from it: the array behind Entries and
+         * Feeds and the nodes of Categories, including each feed's. The
+         * strings inside entries and feeds still use the global heap.
+         */
+        using MemoryResource = std::pmr::memory_resource;
+
+        template<class T>
+        using Vector = std::pmr::vector<T>;
+
+        template<class T>
+        using Set = std::pmr::set<T>;
+#else
+        /**
+         * Stand-in for std::pmr::memory_resource before C++17, the default
+         * build. Containers use the default allocator and any resource given
+         * is ignored.
+         */
+        class MemoryResource;
+
+        template<class T>
+        using Vector = std::vector<T>;
+
+        template<class T>
+        using Set = std::set<T>;
+#endif
+
+        /**
+         * Construct an empty container allocating from resource, or from the
+         * default resource if it is null.
+         */
+        template<class Container>
+        static Container MakeContainer(MemoryResource* resource)
+        {
+#ifdef FDLY_HAS_PMR
+            if (resource != nullptr) {
+                return Container(typename Container::allocator_type(resource));
+            }
+#else
+            (void)resource;
+#endif
+            return Container();
+        }
+
+        /**
+         * Immutable string shared between every copy of it.
+         *
+         * Strings interned through the same StringPool share one allocation,
+         * so comparing them for equality is a pointer compare.
+         *
+         * It converts to const std::string& and concatenates with strings,
+         * but cannot be modified in place: assign a new value or copy it to
+         * a std::string instead.
+         */
+        class InternedString {
+            public:
+                InternedString() :
+                    m_value(Empty())
+                {
+                }
+
+                InternedString(const std::string& value) :
+                    m_value(std::make_shared<const std::string>(value))
+                {
+                }
+
+                InternedString(const char* value) :
+                    m_value(std::make_shared<const std::string>(value))
+                {
+                }
+
+                explicit InternedString(std::shared_ptr<const std::string> value) :
+                    m_value(std::move(value))
+                {
+                }
+
+                const std::string& str() const
+                {
+                    return *m_value;
+                }
+
+                operator const std::string&() const
+                {
+                    return *m_value;
+                }
+
+                const char* c_str() const
+                {
+                    return m_value->c_str();
+                }
+
+                const char* data() const
+                {
+                    return m_value->data();
+                }
+
+                std::string::const_iterator begin() const
+                {
+                    return m_value->begin();
+                }
+
+                std::string::const_iterator end() const
+                {
+                    return m_value->end();
+                }
+
+                std::size_t size() const
+                {
+                    return m_value->size();
+                }
+
+                bool empty() const
+                {
+                    return m_value->empty();
+                }
+
+                int compare(const InternedString& other) const
+                {
+                    return m_value == other.m_value ? 0 : m_value->compare(*other.m_value);
+                }
+
+                int compare(const std::string& other) const
+                {
+                    return m_value->compare(other);
+                }
+
+                friend inline bool operator==(const InternedString& lhs, const InternedString& rhs)
+                {
+                    return lhs.m_value == rhs.m_value || *lhs.m_value == *rhs.m_value;
+                }
+
+                friend inline bool operator!=(const InternedString& lhs, const InternedString& rhs)
+                {
+                    return not (lhs == rhs);
+                }
+
+                friend inline bool operator==(const InternedString& lhs, const std::string& rhs)
+                {
+                    return *lhs.m_value == rhs;
+                }
+
+                friend inline bool operator!=(const InternedString& lhs, const std::string& rhs)
+                {
+                    return *lhs.m_value != rhs;
+                }
+
+                friend inline bool operator==(const InternedString& lhs, const char* rhs)
+                {
+                    return *lhs.m_value == rhs;
+                }
+
+                friend inline bool operator!=(const InternedString& lhs, const char* rhs)
+                {
+                    return *lhs.m_value != rhs;
+                }
+
+                friend inline bool operator==(const std::string& lhs, const InternedString& rhs)
+                {
+                    return rhs == lhs;
+                }
+
+                friend inline bool operator!=(const std::string& lhs, const InternedString& rhs)
+                {
+                    return rhs != lhs;
+                }
+
+                friend inline bool operator==(const char* lhs, const InternedString& rhs)
+                {
+                    return rhs == lhs;
+                }
+
+                friend inline bool operator!=(const char* lhs, const InternedString& rhs)
+                {
+                    return rhs != lhs;
+                }
+
+                friend inline bool operator<(const InternedString& lhs, const InternedString& rhs)
+                {
+                    return lhs.compare(rhs) < 0;
+                }
+
+                friend inline std::string operator+(const InternedString& lhs, const std::string& rhs)
+                {
+                    return *lhs.m_value + rhs;
+                }
+
+                friend inline std::string operator+(const std::string& lhs, const InternedString& rhs)
+                {
+                    return lhs + *rhs.m_value;
+                }
+
+                friend inline std::string operator+(const InternedString& lhs, const char* rhs)
+                {
+                    return *lhs.m_value + rhs;
+                }
+
+                friend inline std::string operator+(const char* lhs, const InternedString& rhs)
+                {
+                    return lhs + *rhs.m_value;
+                }
+
+                friend inline std::ostream& operator<<(std::ostream& out, const InternedString& value)
+                {
+                    return out << *value.m_value;
+                }
+
+            private:
+                static const std::shared_ptr<const std::string>& Empty()
+                {
+                    static const std::shared_ptr<const std::string> empty = std::make_shared<const std::string>();
+                    return empty;
+                }
+
+                std::shared_ptr<const std::string> m_value;
+        };
+
+        /**
+         * Thread-safe table handing out one InternedString per distinct value.
+         *
+         * Strings no longer used outside the pool are dropped whenever the
+         * pool has doubled in size since they were last dropped, which keeps
+         * the cost of interning constant on average.
+         */
+        class StringPool {
+            public:
+                /**
+                 * @param purgeThreshold  size from which unused strings are dropped
+                 */
+                explicit StringPool(std::size_t purgeThreshold = 4096) :
+                    m_purgeThreshold(std::max<std::size_t>(purgeThreshold, 1)),
+                    m_purgeAt(m_purgeThreshold)
+                {
+                }
+
+                StringPool(const StringPool&) = delete;
+                StringPool& operator=(const StringPool&) = delete;
+
+                InternedString Intern(const std::string& value)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    auto it = m_strings.find(&value);
+                    if (it != m_strings.end()) {
+                        return InternedString(it->second);
+                    }
+
+                    if (m_strings.size() >= m_purgeAt) {
+                        PurgeLocked();
+                    }
+
+                    auto stored = std::make_shared<const std::string>(value);
+                    m_strings.emplace(stored.get(), stored);
+                    return InternedString(stored);
+                }
+
+                /**
+                 * Drop the strings that are no longer used outside the pool
+                 * now, instead of waiting for the pool to grow.
+                 *
+                 * @return the number of strings dropped
+                 */
+                std::size_t Purge()
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    return PurgeLocked();
+                }
+
+                std::size_t size() const
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    return m_strings.size();
+                }
+
+            private:
+                std::size_t PurgeLocked()
+                {
+                    // Only the pool can hand out new references, so a string
+                    // it holds the last reference to stays unused
+                    std::size_t dropped = 0;
+                    for (auto it = m_strings.begin(); it != m_strings.end();) {
+                        if (it->second.use_count() == 1) {
+                            it = m_strings.erase(it);
+                            dropped++;
+                        } else {
+                            ++it;
+                        }
+                    }
+                    m_purgeAt = std::max(m_purgeThreshold, 2 * m_strings.size());
+                    return dropped;
+                }
+
+                struct Hash {
+                    std::size_t operator()(const std::string* value) const
+                    {
+                        return std::hash<std::string>()(*value);
+                    }
+                };
+
+                struct Equal {
+                    bool operator()(const std::string* lhs, const std::string* rhs) const
+                    {
+                        return *lhs == *rhs;
+                    }
+                };
+
+                const std::size_t m_purgeThreshold;
+                std::size_t m_purgeAt;
+
+                mutable std::mutex m_mutex;
+                // Keys point into the string owned by their value
+                std::unordered_map<const std::string*, std::shared_ptr<const std::string>, Hash, Equal> m_strings;
+        };
+
+        /**
+         * Forms in which the content of entries can be returned.
+         */
+        enum class ContentFormat {
+            /** Only the HTML content */
+            HTML,
+            /** The HTML content along with its plain text and a snippet */
+            TEXT
+        };
+
         struct Entry {
             /**
              * Actions that can be applied to entries.
@@ -35,18 +395,28 @@ class Fdly {
                 UNREAD
             };
 
-            std::string Content;
-            std::string Title;
-            std::string ID;
-            std::string OriginURL;
-            std::string OriginTitle;
+            std::string    Content;
+            std::string    Title;
+            std::string    ID;
+            InternedString OriginURL;
+            InternedString OriginTitle;
+            /** Plain text of Content, filled for ContentFormat::TEXT */
+            std::string    Text;
+            /** Bounded length preview of Text, filled for ContentFormat::TEXT */
+            std::string    Snippet;
+            /** When the entry was published, in ms since the epoch */
+            long long      Published = 0;
+            /** When Feedly crawled the entry, in ms since the epoch */
+            long long      Crawled = 0;
+            /** Hash of the fields above except Crawled, see Fdly::HashEntry */
+            std::uint64_t  Hash = 0;
 
             Entry(
                     std::string p_content,
                     std::string p_title,
                     std::string p_id,
-                    std::string p_originURL,
-                    std::string p_originTitle) :
+                    InternedString p_originURL,
+                    InternedString p_originTitle) :
                 Content(p_content),
                 Title(p_title),
                 ID(p_id),
@@ -60,7 +430,12 @@ class Fdly {
                 Title(other.Title),
                 ID(other.ID),
                 OriginURL(other.OriginURL),
-                OriginTitle(other.OriginTitle)
+                OriginTitle(other.OriginTitle),
+                Text(other.Text),
+                Snippet(other.Snippet),
+                Published(other.Published),
+                Crawled(other.Crawled),
+                Hash(other.Hash)
             {
             }
 
@@ -69,10 +444,18 @@ class Fdly {
                 Title(other.Title),
                 ID(other.ID),
                 OriginURL(other.OriginURL),
-                OriginTitle(other.OriginTitle)
+                OriginTitle(other.OriginTitle),
+                Text(other.Text),
+                Snippet(other.Snippet),
+                Published(other.Published),
+                Crawled(other.Crawled),
+                Hash(other.Hash)
             {
             }
 
+            Entry& operator=(const Entry& other) = default;
+            Entry& operator=(Entry&& other) = default;
+
             inline bool operator==(const Entry& rhs)
             {
                 return ID == rhs.ID;
@@ -99,7 +482,7 @@ class Fdly {
                         using reference = Entry&;
                         using iterator_category = std::forward_iterator_tag;
 
-                        iterator(std::vector<Entry>::iterator entriesIter) :
+                        iterator(Vector<Entry>::iterator entriesIter) :
                             m_entriesIter(entriesIter)
                         {
                         }
@@ -124,7 +507,7 @@ class Fdly {
                         bool operator!=(const iterator& it) { return m_entriesIter != it.m_entriesIter; }
 
                     private:
-                        std::vector<Entry>::iterator m_entriesIter;
+                        Vector<Entry>::iterator m_entriesIter;
                 };
 
                 class const_iterator {
@@ -135,7 +518,7 @@ class Fdly {
                         using reference = const Entry&;
                         using iterator_category = std::forward_iterator_tag;
 
-                        const_iterator(std::vector<Entry>::const_iterator entriesIter) :
+                        const_iterator(Vector<Entry>::const_iterator entriesIter) :
                             m_entriesIter(entriesIter)
                         {
                         }
@@ -155,14 +538,32 @@ class Fdly {
                         bool operator!=(const const_iterator& it) { return m_entriesIter != it.m_entriesIter; }
 
                     private:
-                        std::vector<Entry>::const_iterator m_entriesIter;
+                        Vector<Entry>::const_iterator m_entriesIter;
                 };
 
                 Entries() = default;
 
+                explicit Entries(MemoryResource* resource) :
+                    m_entries(MakeContainer<Vector<Entry>>(resource))
+                {
+                }
+
                 Entries(const std::vector<Entry>& entries) :
-                    m_entries(entries)
+                    m_entries(entries.begin(), entries.end())
+                {
+                }
+
+                /**
+                 * Continuation ID of the next page, empty on the last page.
+                 */
+                const std::string& continuation() const
+                {
+                    return m_continuation;
+                }
+
+                void setContinuation(const std::string& continuation)
                 {
+                    m_continuation = continuation;
                 }
 
                 void push_back(const Entry& entry)
@@ -172,7 +573,7 @@ class Fdly {
 
                 void push_back(Entry&& entry)
                 {
-                    m_entries.push_back(entry);
+                    m_entries.push_back(std::move(entry));
                 }
 
                 template<class... Args>
@@ -181,6 +582,16 @@ class Fdly {
                     m_entries.emplace_back(std::forward<Args>(args)...);
                 }
 
+                Entry& back()
+                {
+                    return m_entries.back();
+                }
+
+                void reserve(std::size_t size)
+                {
+                    m_entries.reserve(size);
+                }
+
                 inline std::size_t size()
                 {
                     return m_entries.size();
@@ -212,7 +623,8 @@ class Fdly {
                 }
 
             private:
-                std::vector<Entry> m_entries;
+                Vector<Entry> m_entries;
+                std::string m_continuation;
         };
 
         struct Category {
@@ -221,8 +633,8 @@ class Fdly {
                 UNREAD
             };
 
-            std::string Label;
-            std::string ID;
+            InternedString Label;
+            InternedString ID;
 
             friend inline bool operator>(const Category& lhs, const Category& rhs)
             {
@@ -260,7 +672,7 @@ class Fdly {
                         using reference = Category&;
                         using iterator_category = std::forward_iterator_tag;
 
-                        iterator(std::set<Category, std::less<Category>>::iterator ctgsIter) :
+                        iterator(Set<Category>::iterator ctgsIter) :
                             m_ctgsIter(ctgsIter)
                         {
                         }
@@ -280,7 +692,7 @@ class Fdly {
                         bool operator!=(const iterator& it) { return m_ctgsIter != it.m_ctgsIter; }
 
                     private:
-                        std::set<Category, std::less<Category>>::iterator m_ctgsIter;
+                        Set<Category>::iterator m_ctgsIter;
                 };
 
                 class const_iterator {
@@ -291,7 +703,7 @@ class Fdly {
                         using reference = const Category&;
                         using iterator_category = std::forward_iterator_tag;
 
-                        const_iterator(std::set<Category, std::less<Category>>::const_iterator ctgsIter) :
+                        const_iterator(Set<Category>::const_iterator ctgsIter) :
                             m_ctgsIter(ctgsIter)
                         {
                         }
@@ -312,7 +724,7 @@ class Fdly {
                         bool operator!=(const const_iterator& it) const { return m_ctgsIter != it.m_ctgsIter; }
 
                     private:
-                        std::set<Category, std::less<Category>>::const_iterator m_ctgsIter;
+                        Set<Category>::const_iterator m_ctgsIter;
                 };
 
 
@@ -322,6 +734,11 @@ class Fdly {
                 Categories& operator=(Categories& categories) = default;
                 Categories& operator=(Categories&& categories) = default;
 
+                explicit Categories(MemoryResource* resource) :
+                    m_categories(MakeContainer<Set<Category>>(resource))
+                {
+                }
+
                 Categories(const std::vector<Category>& categories)
                 {
                     for (const auto& ctg : categories) {
@@ -391,7 +808,7 @@ class Fdly {
                 }
 
             private:
-                std::set<Category, std::less<Category>> m_categories;
+                Set<Category> m_categories;
         };
 
         struct Feed {
@@ -405,8 +822,10 @@ class Fdly {
             std::string VisualUrl;
             std::string ID;
             std::string SortID;
-            int         Updated;
-            int         Added;
+            /** Last update of the feed, in ms since the epoch */
+            long long   Updated = 0;
+            /** When the feed was subscribed to, in ms since the epoch */
+            long long   Added = 0;
             class Categories  Categories;
         };
 
@@ -420,7 +839,7 @@ class Fdly {
                         using reference = Feed&;
                         using iterator_category = std::forward_iterator_tag;
 
-                        iterator(std::vector<Feed>::iterator feedsIter) :
+                        iterator(Vector<Feed>::iterator feedsIter) :
                             m_feedsIter(feedsIter)
                         {
                         }
@@ -445,7 +864,7 @@ class Fdly {
                         bool operator!=(const iterator& it) { return m_feedsIter != it.m_feedsIter; }
 
                     private:
-                        std::vector<Feed>::iterator m_feedsIter;
+                        Vector<Feed>::iterator m_feedsIter;
                 };
 
                 class const_iterator {
@@ -456,7 +875,7 @@ class Fdly {
                         using reference = const Feed&;
                         using iterator_category = std::forward_iterator_tag;
 
-                        const_iterator(std::vector<Feed>::const_iterator feedsIter) :
+                        const_iterator(Vector<Feed>::const_iterator feedsIter) :
                             m_feedsIter(feedsIter)
                         {
                         }
@@ -476,13 +895,18 @@ class Fdly {
                         bool operator!=(const const_iterator& it) { return m_feedsIter != it.m_feedsIter; }
 
                     private:
-                        std::vector<Feed>::const_iterator m_feedsIter;
+                        Vector<Feed>::const_iterator m_feedsIter;
                 };
 
                 Feeds() = default;
 
+                explicit Feeds(MemoryResource* resource) :
+                    m_feeds(MakeContainer<Vector<Feed>>(resource))
+                {
+                }
+
                 Feeds(const std::vector<Feed>& feeds) :
-                    m_feeds(feeds)
+                    m_feeds(feeds.begin(), feeds.end())
                 {
                 }
 
@@ -493,7 +917,12 @@ class Fdly {
 
                 void push_back(Feed&& feed)
                 {
-                    m_feeds.push_back(feed);
+                    m_feeds.push_back(std::move(feed));
+                }
+
+                void reserve(std::size_t size)
+                {
+                    m_feeds.reserve(size);
                 }
 
                 inline std::size_t size()
@@ -527,80 +956,1326 @@ class Fdly {
                 }
 
             private:
-                std::vector<Feed> m_feeds;
+                Vector<Feed> m_feeds;
 
         };
 
-        /*
-         * Default constructor is not allowed
-         */
-        Fdly() = delete;
-
         /**
-         * Construct a Feedly wrapper with the given user.
+         * Subscriptions indexed by feed ID and by category ID.
          *
-         * @param user  User to accesss Feedly API with
+         * Lookups take a shared lock and hand out shared pointers, so they
+         * can run from any number of threads while the index is updated:
+         *
+         *     const auto& index = connection.GetSubscriptionsIndex();
+         *     if (auto feed = index.Find(feedId)) ...
+         *     index.ForEachInCategory(categoryId, [] (const Fdly::Feed& feed) { ... });
+         *
+         * A list fetched from the server may be older than feeds added or
+         * removed while it was in flight. Its update is therefore opened
+         * with BeginUpdate() before the request is sent, and Assign()
+         * replays the changes made since on top of it.
          */
-        Fdly(User& user, std::string apiVersion = APIVersion3) :
-            m_user(user),
-            m_effectiveAPIVersion(apiVersion),
-            m_rootUrl(std::string(Fdly::FeedlyUrl) + "/" + m_effectiveAPIVersion)
-        {
-        }
+        class FeedIndex {
+            public:
+                using FeedPtr = std::shared_ptr<const Feed>;
+                using Version = std::uint64_t;
 
+                FeedIndex() = default;
+                FeedIndex(const FeedIndex&) = delete;
+                FeedIndex& operator=(const FeedIndex&) = delete;
 
-        /**
-         * Ensure that we can Authenticate with the Feedly API.
-         *
-         * @return - true if Authentication was sucessful.
-         *         - false if Authentication failed.
-         */
-        bool CanAuthenticate()
-        {
-            auto r = cpr::Get(cpr::Url{m_rootUrl + "/profile"},
-                              cpr::Header{{"Authorization", "OAuth " + m_user.AuthToken}});
+                explicit FeedIndex(const Feeds& feeds)
+                {
+                    Assign(feeds);
+                }
 
-            if (r.status_code == 200) {
-                return true;
-            }
+                /**
+                 * Replace the whole content of the index.
+                 */
+                void Assign(const Feeds& feeds)
+                {
+                    Assign(feeds, BeginUpdate());
+                }
 
-            return false;
-        }
+                /**
+                 * Start replacing the content of the index with a list
+                 * about to be fetched. Every call must be followed by
+                 * Assign() with the version returned, or by AbandonUpdate().
+                 *
+                 * @return the version the fetched list will be based on
+                 */
+                Version BeginUpdate()
+                {
+                    std::lock_guard<std::shared_timed_mutex> lock(m_mutex);
+                    m_updating++;
+                    return m_version;
+                }
 
+                /**
+                 * Replace the content of the index with a list fetched
+                 * after BeginUpdate() returned since, keeping the feeds added
+                 * and removed after that. A list older than one already
+                 * assigned is dropped.
+                 */
+                void Assign(const Feeds& feeds, Version since)
+                {
+                    std::unordered_map<std::string, FeedPtr> byId;
+                    std::unordered_map<std::string, std::vector<FeedPtr>> byCategory;
+                    for (const auto& feed : feeds) {
+                        auto stored = std::make_shared<const Feed>(feed);
+                        auto inserted = byId.emplace(feed.ID, stored);
+                        if (not inserted.second) {
+                            continue;
+                        }
+                        for (const auto& ctg : feed.Categories) {
+                            byCategory[ctg.ID.str()].push_back(stored);
+                        }
+                    }
 
-        /**
-         * Return the available categories.
-         *
-         * @return a map with the category label as a key and the category id as a value
-         */
-        Categories GetCategories() const
-        {
-            auto r = cpr::Get(cpr::Url{m_rootUrl + "/categories"},
-                              cpr::Header{{"Authorization", "OAuth " + m_user.AuthToken}});
+                    std::lock_guard<std::shared_timed_mutex> lock(m_mutex);
+                    if (since >= m_assigned) {
+                        m_byId.swap(byId);
+                        m_byCategory.swap(byCategory);
+                        m_assigned = since;
+
+                        for (const auto& change : m_changes) {
+                            if (change.At <= since) {
+                                continue;
+                            }
+                            if (change.Feed) {
+                                Put(change.Feed);
+                            } else {
+                                Erase(change.ID);
+                            }
+                        }
+                    }
+                    EndUpdate();
+                }
 
+                /**
+                 * Give up an update started with BeginUpdate(), for example
+                 * because the list could not be fetched.
+                 */
+                void AbandonUpdate()
+                {
+                    std::lock_guard<std::shared_timed_mutex> lock(m_mutex);
+                    EndUpdate();
+                }
 
-            if (r.status_code not_eq 200) {
-                std::string error = "Could not get categories: " + std::to_string(r.status_code);
-                throw std::runtime_error(error.c_str());
-            }
+                /**
+                 * Add a feed, or replace the feed with the same ID.
+                 */
+                void Add(const Feed& feed)
+                {
+                    auto stored = std::make_shared<const Feed>(feed);
 
-            auto jsonResp = json::parse(r.text);
+                    std::lock_guard<std::shared_timed_mutex> lock(m_mutex);
+                    Put(stored);
+                    Record(feed.ID, stored);
+                }
 
-            Categories categories;
-            for (auto& ctg : jsonResp) {
-                categories.append(Category {.Label = ctg["label"], .ID = ctg["id"]});
-            }
+                /**
+                 * Remove a feed.
+                 *
+                 * @return whether the feed was in the index
+                 */
+                bool Remove(const std::string& feedId)
+                {
+                    std::lock_guard<std::shared_timed_mutex> lock(m_mutex);
+                    Record(feedId, nullptr);
+                    return Erase(feedId);
+                }
 
-            return categories;
-        }
+                /**
+                 * Return the feed with the given ID, or null.
+                 */
+                FeedPtr Find(const std::string& feedId) const
+                {
+                    std::shared_lock<std::shared_timed_mutex> lock(m_mutex);
+                    auto it = m_byId.find(feedId);
+                    return it != m_byId.end() ? it->second : nullptr;
+                }
 
+                /**
+                 * Call f with every feed of a category, while holding the
+                 * shared lock.
+                 */
+                template<class F>
+                void ForEachInCategory(const std::string& categoryId, F&& f) const
+                {
+                    std::shared_lock<std::shared_timed_mutex> lock(m_mutex);
+                    auto it = m_byCategory.find(categoryId);
+                    if (it == m_byCategory.end()) {
+                        return;
+                    }
+                    for (const auto& feed : it->second) {
+                        f(*feed);
+                    }
+                }
+
+                /**
+                 * Return the feeds of a category.
+                 */
+                std::vector<FeedPtr> InCategory(const std::string& categoryId) const
+                {
+                    std::shared_lock<std::shared_timed_mutex> lock(m_mutex);
+                    auto it = m_byCategory.find(categoryId);
+                    if (it == m_byCategory.end()) {
+                        return {};
+                    }
+                    return it->second;
+                }
+
+                std::size_t size() const
+                {
+                    std::shared_lock<std::shared_timed_mutex> lock(m_mutex);
+                    return m_byId.size();
+                }
+
+                bool empty() const
+                {
+                    return size() == 0;
+                }
+
+            private:
+                /**
+                 * A feed added, or removed when Feed is null, while updates
+                 * were in progress.
+                 */
+                struct Change {
+                    Version     At;
+                    std::string ID;
+                    FeedPtr     Feed;
+                };
+
+                void Put(const FeedPtr& stored)
+                {
+                    auto it = m_byId.find(stored->ID);
+                    if (it != m_byId.end()) {
+                        Unlink(it->second);
+                        it->second = stored;
+                    } else {
+                        m_byId.emplace(stored->ID, stored);
+                    }
+
+                    for (const auto& ctg : stored->Categories) {
+                        m_byCategory[ctg.ID.str()].push_back(stored);
+                    }
+                }
+
+                bool Erase(const std::string& feedId)
+                {
+                    auto it = m_byId.find(feedId);
+                    if (it == m_byId.end()) {
+                        return false;
+                    }
+
+                    Unlink(it->second);
+                    m_byId.erase(it);
+                    return true;
+                }
+
+                /**
+                 * Count a change, and keep it for the updates in progress
+                 * to replay.
+                 */
+                void Record(const std::string& feedId, FeedPtr feed)
+                {
+                    m_version++;
+                    if (m_updating > 0) {
+                        m_changes.push_back(Change {m_version, feedId, std::move(feed)});
+                    }
+                }
+
+                void EndUpdate()
+                {
+                    if (m_updating > 0 && --m_updating == 0) {
+                        m_changes.clear();
+                    }
+                }
+
+                void Unlink(const FeedPtr& feed)
+                {
+                    for (const auto& ctg : feed->Categories) {
+                        auto it = m_byCategory.find(ctg.ID.str());
+                        if (it == m_byCategory.end()) {
+                            continue;
+                        }
+
+                        auto& feeds = it->second;
+                        feeds.erase(std::remove(feeds.begin(), feeds.end(), feed), feeds.end());
+                        if (feeds.empty()) {
+                            m_byCategory.erase(it);
+                        }
+                    }
+                }
+
+                mutable std::shared_timed_mutex m_mutex;
+                std::unordered_map<std::string, FeedPtr> m_byId;
+                std::unordered_map<std::string, std::vector<FeedPtr>> m_byCategory;
+                std::vector<Change> m_changes;
+                Version m_version = 0;
+                Version m_assigned = 0;
+                unsigned int m_updating = 0;
+        };
+
+        /**
+         * Hash the fields of an entry that identify its content: the ID,
+         * title, content, origin and publication time. Text and Snippet are
+         * derived from the content and Crawled changes without the entry
+         * changing, so they are left out.
+         *
+         * GetEntries stores this hash in Entry::Hash.
+         */
+        static std::uint64_t HashEntry(const Entry& entry)
+        {
+            std::uint64_t hash = 0;
+            hash = HashBytes(entry.ID.data(), entry.ID.size(), hash);
+            hash = HashBytes(entry.Title.data(), entry.Title.size(), hash);
+            hash = HashBytes(entry.Content.data(), entry.Content.size(), hash);
+            hash = HashBytes(entry.OriginURL.str().data(), entry.OriginURL.size(), hash);
+            hash = HashBytes(entry.OriginTitle.str().data(), entry.OriginTitle.size(), hash);
+            hash = HashBytes(reinterpret_cast<const char*>(&entry.Published), sizeof(entry.Published), hash);
+            return hash;
+        }
+
+        /**
+         * Filters out the entries already seen with the same content.
+         *
+         * The tracker remembers the hash of every entry it lets through, so
+         * feeding it each fetched page yields only the entries that are new
+         * or whose content changed since:
+         *
+         *     Fdly::ChangeTracker tracker(LoadHashes());
+         *     for (const auto& entry : tracker.Filter(connection.GetEntries("All"))) {
+         *         Process(entry);
+         *     }
+         *     SaveHashes(tracker.Hashes());
+         */
+        class ChangeTracker {
+            public:
+                using HashTable = std::unordered_map<std::string, std::uint64_t>;
+
+                ChangeTracker() = default;
+
+                /**
+                 * @param hashes  the entry hashes stored by a previous run
+                 */
+                explicit ChangeTracker(HashTable hashes) :
+                    m_hashes(std::move(hashes))
+                {
+                }
+
+                /**
+                 * Return whether an entry is new or modified, and remember
+                 * its current hash.
+                 */
+                bool Changed(const Entry& entry)
+                {
+                    std::uint64_t hash = entry.Hash not_eq 0 ? entry.Hash : HashEntry(entry);
+
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    auto it = m_hashes.find(entry.ID);
+                    if (it == m_hashes.end()) {
+                        m_hashes.emplace(entry.ID, hash);
+                        return true;
+                    }
+                    if (it->second not_eq hash) {
+                        it->second = hash;
+                        return true;
+                    }
+                    return false;
+                }
+
+                /**
+                 * Return the new and modified entries of a page, keeping its
+                 * continuation.
+                 */
+                Entries Filter(const Entries& entries)
+                {
+                    Entries changed;
+                    for (const auto& entry : entries) {
+                        if (Changed(entry)) {
+                            changed.push_back(entry);
+                        }
+                    }
+                    changed.setContinuation(entries.continuation());
+                    return changed;
+                }
+
+                /**
+                 * Forget an entry, e.g. once it has been deleted downstream.
+                 */
+                void Forget(const std::string& id)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_hashes.erase(id);
+                }
+
+                /**
+                 * Return a copy of the hashes, to be stored for the next run.
+                 */
+                HashTable Hashes() const
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    return m_hashes;
+                }
+
+                std::size_t size() const
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    return m_hashes.size();
+                }
+
+            private:
+                mutable std::mutex m_mutex;
+                HashTable m_hashes;
+        };
+
+        /**
+         * Byte counts of the response bodies received so far, as they came
+         * over the wire and after decompression.
+         */
+        struct TransferStats {
+            unsigned long long Responses;
+            unsigned long long CompressedBytes;
+            unsigned long long UncompressedBytes;
+        };
+
+        /**
+         * Counters of the cache of entries pages.
+         */
+        struct CacheStats {
+            unsigned long long Hits;
+            unsigned long long Misses;
+            unsigned long long Evictions;
+            /** Estimated size of the cached pages */
+            std::size_t        Bytes;
+            std::size_t        Pages;
+        };
+
+        /**
+         * Startup behaviour of a connection.
+         */
+        struct Options {
+            /**
+             * Resolve the API host and open a connection to it in the
+             * background at construction, to be used by the first request.
+             */
+            bool WarmUp = false;
+
+            /**
+             * Make CanAuthenticate() rely on the responses of the regular
+             * requests instead of a separate /profile request.
+             */
+            bool LazyAuthentication = false;
+
+            /**
+             * Scheme and host of the API, FeedlyUrl when empty. Meant for
+             * pointing a connection at a local stand-in in tests.
+             */
+            std::string BaseUrl;
+
+            /**
+             * Performs the requests in place of the pooled sessions when
+             * set, given the method ("GET" or "POST"), URL, headers and
+             * body. Meant for serving canned responses in tests; no warm-up
+             * is done through it.
+             */
+            std::function<cpr::Response(const char* method, const std::string& url,
+                    const cpr::Header& header, const std::string& body)> Transport;
+        };
+
+        /**
+         * What the responses received so far tell about the credentials.
+         */
+        enum class AuthState {
+            /** No response received yet */
+            UNKNOWN,
+            /** A request succeeded */
+            VALID,
+            /** A request was rejected as unauthorized */
+            INVALID
+        };
+
+        /*
+         * Default constructor is not allowed
+         */
+        Fdly() = delete;
+
+        /**
+         * Construct a Feedly wrapper with the given user.
+         *
+         * @param user  User to accesss Feedly API with
+         */
+        Fdly(User& user, std::string apiVersion = APIVersion3) :
+            Fdly(user, Options {}, apiVersion)
+        {
+        }
+
+        /**
+         * Construct a Feedly wrapper with the given user and startup options.
+         *
+         * @param user     User to accesss Feedly API with
+         * @param options  warm-up and authentication behaviour
+         */
+        Fdly(User& user, const Options& options, std::string apiVersion = APIVersion3) :
+            m_user(user),
+            m_effectiveAPIVersion(apiVersion),
+            m_baseUrl(options.BaseUrl.empty() ? std::string(Fdly::FeedlyUrl) : options.BaseUrl),
+            m_rootUrl(m_baseUrl + "/" + m_effectiveAPIVersion),
+            m_profileUrl(m_rootUrl + "/profile"),
+            m_categoriesUrl(m_rootUrl + "/categories"),
+            m_subscriptionsUrl(m_rootUrl + "/subscriptions"),
+            m_markersUrl(m_rootUrl + "/markers"),
+            m_streamsUrl(m_rootUrl + "/streams/contents"),
+            m_allStream("user/" + m_user.ID + "/category/global.all"),
+            m_uncategorizedStream("user/" + m_user.ID + "/category/global.uncategorized"),
+            m_savedStream("user/" + m_user.ID + "/tag/global.saved"),
+            m_transport(options.Transport),
+            m_lazyAuthentication(options.LazyAuthentication),
+            m_authState(static_cast<int>(AuthState::UNKNOWN)),
+            m_compression(true),
+            m_responses(0),
+            m_compressedBytes(0),
+            m_uncompressedBytes(0)
+        {
+            BuildHeaders();
+
+            if (options.WarmUp && not m_transport) {
+                m_warmUp = std::async(std::launch::async, [this] () {
+                    WarmUp();
+                }).share();
+            }
+        }
+
+        // Neither copyable nor movable, see the class description
+        Fdly(const Fdly&) = delete;
+        Fdly& operator=(const Fdly&) = delete;
+
+
+        /**
+         * Enable or disable compressed transfer of response bodies.
+         *
+         * When enabled (the default) every request advertises the encodings
+         * we can decode and responses are decompressed before parsing.
+         *
+         * @param enabled  whether to request compressed responses
+         */
+        void SetCompression(bool enabled)
+        {
+            m_compression = enabled;
+        }
+
+
+        /**
+         * Return the transfer statistics accumulated by this connection.
+         */
+        TransferStats GetTransferStats() const
+        {
+            return TransferStats {
+                m_responses.load(),
+                m_compressedBytes.load(),
+                m_uncompressedBytes.load()
+            };
+        }
+
+
+        /**
+         * Reset the transfer statistics to zero.
+         */
+        void ResetTransferStats()
+        {
+            m_responses = 0;
+            m_compressedBytes = 0;
+            m_uncompressedBytes = 0;
+        }
+
+
+        /**
+         * Set the memory budget of the cache of entries pages.
+         *
+         * GetEntries keeps the pages it has fetched and returns them again
+         * for the same stream, ranking, read filter, count and continuation
+         * without going back to the network. Once the estimated size of the
+         * cached pages exceeds the budget the least recently used ones are
+         * evicted. Pages older than maxAge are fetched again, which bounds
+         * how stale a page can be when the stream changes on the server.
+         *
+         * Marking a category drops every cached page, since the category's
+         * entries may appear in any stream; marking entries drops the pages
+         * of every stream in which a cached page contains one of them.
+         *
+         * @param bytes   the budget, 0 (the default) disables the cache
+         * @param maxAge  how long a page is served from the cache
+         */
+        void SetEntriesCacheBudget(std::size_t bytes, std::chrono::milliseconds maxAge = std::chrono::minutes(1))
+        {
+            m_entriesCache.SetBudget(bytes, maxAge);
+        }
+
+
+        /**
+         * Return the counters of the cache of entries pages.
+         */
+        CacheStats GetEntriesCacheStats() const
+        {
+            return m_entriesCache.Stats();
+        }
+
+
+        /**
+         * Drop the cached pages of a stream, so that they are fetched again.
+         *
+         * @param categoryId  the stream, as passed to GetEntries
+         */
+        void InvalidateEntriesCache(const std::string& categoryId)
+        {
+            m_entriesCache.InvalidateStream(StreamId(categoryId));
+        }
+
+
+        /**
+         * Drop all cached pages.
+         */
+        void ClearEntriesCache()
+        {
+            m_entriesCache.Clear();
+        }
+
+
+        /**
+         * Ensure that we can Authenticate with the Feedly API.
+         *
+         * With lazy authentication no request is made: the answer comes from
+         * the responses received so far, and is optimistically true until
+         * the first one arrives.
+         *
+         * @return - true if Authentication was sucessful.
+         *         - false if Authentication failed.
+         */
+        bool CanAuthenticate()
+        {
+            if (m_lazyAuthentication) {
+                return GetAuthState() not_eq AuthState::INVALID;
+            }
+
+            auto r = SendGet(m_profileUrl);
+            NoteAuthentication(r);
+
+            if (r.status_code == 200) {
+                return true;
+            }
+
+            return false;
+        }
+
+
+        /**
+         * Return what the responses received so far tell about the
+         * credentials.
+         */
+        AuthState GetAuthState() const
+        {
+            return static_cast<AuthState>(m_authState.load());
+        }
+
+
+        /**
+         * Return the available categories.
+         *
+         * @return a map with the category label as a key and the category id as a value
+         */
+        Categories GetCategories() const
+        {
+            return m_categoriesFlight.Do("categories", [this] () {
+                return GetCategories(nullptr);
+            });
+        }
+
+
+        /**
+         * Return the available categories, allocated from a memory resource.
+         *
+         * Unlike GetCategories(), this call is never coalesced with others.
+         *
+         * @param resource  the resource to allocate the result from
+         */
+        Categories GetCategories(MemoryResource* resource) const
+        {
+            auto r = SendGet(m_categoriesUrl);
+
+            return ParseCategories(r, resource);
+        }
+
+
+        /**
+         * Mark category with an action.
+         *
+         * Every cached entries page is dropped on completion, since the
+         * category's entries may appear in any stream.
+         *
+         * @param categoryID  the category to mark
+         * @param action      the action to apply
+         */
+        void MarkCategoryAs(std::string categoryID, Category::Action action, const std::string& lastReadEntryId = "") const
+        {
+            auto r = SendPost(m_markersUrl, MarkCategoryBody(categoryID, action, lastReadEntryId));
+
+            CompleteMarkCategory(r, action);
+        }
+
+
+        /**
+         * Mark entry with an action.
+         *
+         * @param action  the action to apply
+         */
+        void MarkEntryAs(Entry::Action action)
+        {
+            // TODO
+        }
+
+        /**
+         * Mark a multiple entries with an action.
+         *
+         * @param entryId  list of IDs for the entries to apply the action to
+         * @param action  the action to apply
+         */
+        void MarkEntriesWithAction(const std::vector<std::string>& entryIds, Entry::Action action)
+        {
+            if (entryIds.size() > 0) {
+                auto r = SendPost(m_markersUrl, MarkEntriesBody(entryIds, action));
+
+                CompleteMarkEntries(r, entryIds, action);
+            }
+        }
+
+        /**
+         * Get list of subscribed feeds
+         */
+        Feeds GetSubscriptions()
+        {
+            return m_subscriptionsFlight.Do("subscriptions", [this] () {
+                auto since = m_subscriptionsIndex.BeginUpdate();
+                try {
+                    auto feeds = GetSubscriptions(nullptr);
+                    m_subscriptionsIndex.Assign(feeds, since);
+                    return feeds;
+                } catch (...) {
+                    m_subscriptionsIndex.AbandonUpdate();
+                    throw;
+                }
+            });
+        }
+
+        /**
+         * Get list of subscribed feeds, allocated from a memory resource.
+         *
+         * Unlike GetSubscriptions(), this call is never coalesced with others
+         * and leaves the subscriptions index alone, so that no feed is
+         * copied out of the resource.
+         *
+         * @param resource  the resource to allocate the result from
+         */
+        Feeds GetSubscriptions(MemoryResource* resource)
+        {
+            auto r = SendGet(m_subscriptionsUrl);
+
+            return ParseSubscriptions(r, resource);
+        }
+
+        /**
+         * Return the subscriptions indexed by feed and category ID.
+         *
+         * The index is rebuilt by every GetSubscriptions() call without a
+         * memory resource and updated in place by AddSubscription(), and is
+         * empty until the first of them.
+         */
+        const FeedIndex& GetSubscriptionsIndex() const
+        {
+            return m_subscriptionsIndex;
+        }
+
+        /**
+         * Subscribe to a feed
+         *
+         * @param feed  the feed to subscribe to
+         */
+        void AddSubscription(const Feed& feed)
+        {
+            json j;
+            j["id"] = "feed/" + feed.Url;
+            j["title"] = feed.Title;
+
+            if (not feed.Categories.empty()) {
+                for (const auto& ctg : feed.Categories) {
+                    j["categories"].push_back({{"label", ctg.Label.str()},
+                                               {"id",    ctg.ID.str()}});
+                }
+            } else {
+                j["categories"] = json::array();
+            }
+
+            auto r = SendPost(m_subscriptionsUrl, j.dump());
+            NoteAuthentication(r);
+
+            if (r.status_code not_eq 200) {
+                std::string error = "Could not add subscription: " + std::to_string(r.status_code);
+                throw std::runtime_error(error.c_str());
+            }
+
+            Feed subscribed = feed;
+            subscribed.ID = j["id"];
+            m_subscriptionsIndex.Add(subscribed);
+        }
+
+        Entries GetEntries(
+                const Category& category,
+                bool sortByOldest = false,
+                unsigned int count = 20,
+                bool unreadOnly = true,
+                const std::string& continuationId = "",
+                unsigned long newerThan = 0,
+                ContentFormat format = ContentFormat::HTML,
+                MemoryResource* resource = nullptr
+                ) const
+        {
+            return GetEntries(category.ID, sortByOldest, count, unreadOnly, continuationId, newerThan, format, resource);
+        }
+
+        /**
+         * Return entries for a specific category.
+         *
+         * @param categoryId     the category to fetch entries from
+         * @param sortByOldest   return the list of entries ordered by oldest
+         * @param count          number of entries to fetch
+         * @param unreadOnly     fetch only unread entries
+         * @param continuationId fetch entries after a specific id
+         * @param newerThan      fetch entries newer than timestamp in ms
+         * @param format         whether to also extract the text of the content
+         * @param resource       allocate the result from this resource; such
+         *                       calls are never coalesced with others
+         *
+         * @return a list of entries
+         */
+        Entries GetEntries(
+                const std::string& categoryId,
+                bool sortByOldest = false,
+                unsigned int count = 20,
+                bool unreadOnly = true,
+                const std::string& continuationId = "",
+                unsigned long newerThan = 0,
+                ContentFormat format = ContentFormat::HTML,
+                MemoryResource* resource = nullptr
+                ) const
+        {
+            const std::string& url = EntriesUrl(categoryId, sortByOldest, count, unreadOnly, continuationId, newerThan);
+
+            if (resource != nullptr) {
+                return ParseEntries(SendGet(url), format, resource);
+            }
+
+            // The URL identifies the page; the format tells apart the results
+            thread_local std::string key;
+            key.assign(url);
+            key += format == ContentFormat::TEXT ? "#text" : "#html";
+
+            Entries cached;
+            auto generation = m_entriesCache.Generation();
+            if (m_entriesCache.Find(key, cached)) {
+                return cached;
+            }
+
+            return m_entriesFlight.Do(key, [this, &url, &categoryId, format, generation] () {
+                auto r = SendGet(url);
+
+                auto entries = ParseEntries(r, format);
+                m_entriesCache.Insert(key, StreamId(categoryId), entries, generation);
+                return entries;
+            });
+        }
+
+        /**
+         * Length in bytes of the snippets extracted for ContentFormat::TEXT.
+         */
+        static constexpr std::size_t SnippetLength = 200;
+
+        /**
+         * Return the URL GetEntries requests for the given parameters.
+         *
+         * The URL is built in a buffer reused by the calling thread, so once
+         * it has grown to size this does not allocate. The reference stays
+         * valid until the next call on the same thread.
+         */
+        const std::string& EntriesUrl(
+                const std::string& categoryId,
+                bool sortByOldest = false,
+                unsigned int count = 20,
+                bool unreadOnly = true,
+                const std::string& continuationId = "",
+                unsigned long newerThan = 0) const
+        {
+            thread_local std::string url;
+
+            url.assign(m_streamsUrl);
+            url += sortByOldest ? "?ranked=oldest" : "?ranked=newest";
+            url += unreadOnly ? "&unreadOnly=true" : "&unreadOnly=false";
+            url += "&count=";
+            AppendNumber(url, count);
+
+            if (not continuationId.empty()) {
+                url += "&continuation=";
+                AppendEscaped(url, continuationId);
+            }
+
+            if (newerThan > 0) {
+                url += "&newerThan=";
+                AppendNumber(url, newerThan);
+            }
+
+            url += "&streamId=";
+            AppendEscaped(url, StreamId(categoryId));
+
+            return url;
+        }
+
+        /**
+         * Get a list of unread counts
+         */
+        void UnreadCounts()
+        {
+            //TODO
+        }
+
+        /**
+         * Return the pool interning the origin, category label and category
+         * ID strings of the results returned by this connection.
+         *
+         * Strings no longer referenced by any result are released as the
+         * pool grows; Purge() releases them right away.
+         */
+        StringPool& GetStringPool() const
+        {
+            return m_strings;
+        }
+
+        /**
+         * Return the stream ID of the user's category with the given label.
+         *
+         * @param label  the category label
+         */
+        std::string CategoryID(const std::string& label) const
+        {
+            return "user/" + m_user.ID + "/category/" + label;
+        }
+
+        /**
+         * Check if Feedly is available
+         *
+         * @return true if we can reach cloud.feedly.com, false otherwise
+         */
+        static inline bool IsAvailable();
+
+        static constexpr const char* FeedlyUrl = "https://cloud.feedly.com";
+
+        static constexpr const char* APIVersion3 = "v3";
+
+    private:
+        friend class FdlyAsync;
+        friend class EntriesPipeline;
+        friend class FdlyAccounts;
+
+        /**
+         * Coalesces concurrent identical calls.
+         *
+         * The first caller for a key performs the call; callers arriving
+         * while it is in flight wait for it and receive a copy of the same
+         * parsed result, or the same exception.
+         *
+         * The leader keeps the call's state and result on its own stack and
+         * waits for the other callers to copy the result before returning
+         * it, so a call that nobody joins does not allocate.
+         */
+        template<class T>
+        class SingleFlight {
+            public:
+                SingleFlight()
+                {
+                    m_flights.reserve(16);
+                }
+
+                template<class Call>
+                T Do(const std::string& key, Call&& call)
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    for (Flight* flight : m_flights) {
+                        if (*flight->Key == key) {
+                            return Follow(*flight, lock);
+                        }
+                    }
+
+                    Flight flight(key);
+                    m_flights.push_back(&flight);
+                    lock.unlock();
+
+                    T result;
+                    try {
+                        result = call();
+                    } catch (...) {
+                        flight.Error = std::current_exception();
+                    }
+
+                    lock.lock();
+                    flight.Result = &result;
+                    flight.Done = true;
+                    m_flights.erase(std::find(m_flights.begin(), m_flights.end(), &flight));
+                    m_changed.notify_all();
+                    m_changed.wait(lock, [&flight] { return flight.Waiters == 0; });
+                    lock.unlock();
+
+                    if (flight.Error) {
+                        std::rethrow_exception(flight.Error);
+                    }
+                    return result;
+                }
+
+            private:
+                struct Flight {
+                    explicit Flight(const std::string& key) :
+                        Key(&key)
+                    {
+                    }
+
+                    // The leader's key, left untouched while it is in Do
+                    const std::string* Key;
+                    const T* Result = nullptr;
+                    std::exception_ptr Error;
+                    bool Done = false;
+                    std::size_t Waiters = 0;
+                };
+
+                T Follow(Flight& flight, std::unique_lock<std::mutex>& lock)
+                {
+                    flight.Waiters++;
+                    m_changed.wait(lock, [&flight] { return flight.Done; });
+                    lock.unlock();
+
+                    // The leader waits for every follower to leave before
+                    // its result goes out of scope
+                    try {
+                        if (flight.Error) {
+                            std::rethrow_exception(flight.Error);
+                        }
+                        T copy(*flight.Result);
+                        Leave(flight, lock);
+                        return copy;
+                    } catch (...) {
+                        Leave(flight, lock);
+                        throw;
+                    }
+                }
+
+                void Leave(Flight& flight, std::unique_lock<std::mutex>& lock)
+                {
+                    lock.lock();
+                    if (--flight.Waiters == 0) {
+                        m_changed.notify_all();
+                    }
+                }
+
+                std::mutex m_mutex;
+                std::condition_variable m_changed;
+                std::vector<Flight*> m_flights;
+        };
+
+        /**
+         * Byte-budgeted LRU cache of parsed entries pages.
+         */
+        class PageCache {
+            public:
+                void SetBudget(std::size_t bytes, std::chrono::milliseconds maxAge)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_budget = bytes;
+                    m_maxAge = maxAge;
+                    Shrink();
+                }
+
+                bool Find(const std::string& key, Entries& entries)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_budget == 0) {
+                        return false;
+                    }
+
+                    auto it = m_index.find(&key);
+                    if (it == m_index.end()) {
+                        m_misses++;
+                        return false;
+                    }
+
+                    if (Clock::now() - it->second->Fetched > m_maxAge) {
+                        Erase(it->second);
+                        m_evictions++;
+                        m_misses++;
+                        return false;
+                    }
+
+                    m_pages.splice(m_pages.begin(), m_pages, it->second);
+                    entries = it->second->Entries;
+                    m_hits++;
+                    return true;
+                }
+
+                /**
+                 * Incremented by every invalidation. A page fetched while
+                 * it changed may predate the invalidation and is not cached.
+                 */
+                unsigned long long Generation() const
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    return m_generation;
+                }
+
+                void Insert(const std::string& key, const std::string& streamId, const Entries& entries, unsigned long long generation)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_budget == 0 || generation != m_generation) {
+                        return;
+                    }
+
+                    auto it = m_index.find(&key);
+                    if (it != m_index.end()) {
+                        Erase(it->second);
+                    }
+
+                    std::size_t bytes = PageBytes(key, streamId, entries);
+                    if (bytes > m_budget) {
+                        return;
+                    }
+
+                    m_pages.push_front(Page {key, streamId, entries, bytes, Clock::now()});
+                    m_index.emplace(&m_pages.front().Key, m_pages.begin());
+                    m_bytes += bytes;
+                    Shrink();
+                }
+
+                void InvalidateStream(const std::string& streamId)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_generation++;
+                    for (auto it = m_pages.begin(); it != m_pages.end();) {
+                        auto next = std::next(it);
+                        if (it->StreamId == streamId) {
+                            Erase(it);
+                        }
+                        it = next;
+                    }
+                }
+
+                void InvalidateEntries(const std::vector<std::string>& entryIds)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_generation++;
+                    if (m_pages.empty()) {
+                        return;
+                    }
+
+                    std::set<std::string> ids(entryIds.begin(), entryIds.end());
+                    std::set<std::string> streams;
+                    for (const auto& page : m_pages) {
+                        for (const auto& entry : page.Entries) {
+                            if (ids.count(entry.ID) > 0) {
+                                streams.insert(page.StreamId);
+                                break;
+                            }
+                        }
+                    }
+
+                    for (auto it = m_pages.begin(); it != m_pages.end();) {
+                        auto next = std::next(it);
+                        if (streams.count(it->StreamId) > 0) {
+                            Erase(it);
+                        }
+                        it = next;
+                    }
+                }
+
+                void Clear()
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_generation++;
+                    m_pages.clear();
+                    m_index.clear();
+                    m_bytes = 0;
+                }
+
+                CacheStats Stats() const
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    return CacheStats {m_hits, m_misses, m_evictions, m_bytes, m_pages.size()};
+                }
+
+            private:
+                using Clock = std::chrono::steady_clock;
+
+                struct KeyHash {
+                    std::size_t operator()(const std::string* key) const
+                    {
+                        return std::hash<std::string>()(*key);
+                    }
+                };
+
+                struct KeyEqual {
+                    bool operator()(const std::string* lhs, const std::string* rhs) const
+                    {
+                        return *lhs == *rhs;
+                    }
+                };
+
+                struct Page {
+                    std::string Key;
+                    std::string StreamId;
+                    Fdly::Entries Entries;
+                    std::size_t Bytes;
+                    Clock::time_point Fetched;
+                };
+
+                /**
+                 * Estimate the memory held by a page. The interned origin
+                 * strings are shared with other results and not counted.
+                 */
+                static std::size_t PageBytes(const std::string& key, const std::string& streamId, const Entries& entries)
+                {
+                    std::size_t bytes = sizeof(Page) + key.capacity() + streamId.capacity()
+                        + entries.continuation().capacity();
+                    for (const auto& entry : entries) {
+                        bytes += sizeof(Entry) + entry.Content.capacity() + entry.Title.capacity()
+                            + entry.ID.capacity() + entry.Text.capacity() + entry.Snippet.capacity();
+                    }
+                    return bytes;
+                }
+
+                void Erase(std::list<Page>::iterator page)
+                {
+                    m_bytes -= page->Bytes;
+                    m_index.erase(&page->Key);
+                    m_pages.erase(page);
+                }
+
+                void Shrink()
+                {
+                    while (m_bytes > m_budget && not m_pages.empty()) {
+                        Erase(std::prev(m_pages.end()));
+                        m_evictions++;
+                    }
+                }
+
+                mutable std::mutex m_mutex;
+                std::size_t m_budget = 0;
+                std::chrono::milliseconds m_maxAge {0};
+                std::size_t m_bytes = 0;
+                std::list<Page> m_pages;
+                // Keys point into the key of the page they index
+                std::unordered_map<const std::string*, std::list<Page>::iterator, KeyHash, KeyEqual> m_index;
+                unsigned long long m_hits = 0;
+                unsigned long long m_misses = 0;
+                unsigned long long m_evictions = 0;
+                unsigned long long m_generation = 0;
+        };
+
+        /**
+         * MurmurHash64A, eight bytes at a time. The seed chains the hashes
+         * of consecutive fields.
+         */
+        static std::uint64_t HashBytes(const char* data, std::size_t length, std::uint64_t seed)
+        {
+            const std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+            const int r = 47;
+
+            std::uint64_t h = seed ^ (length * m);
+
+            const char* end = data + (length & ~static_cast<std::size_t>(7));
+            for (; data != end; data += 8) {
+                std::uint64_t k;
+                std::memcpy(&k, data, sizeof(k));
+
+                k *= m;
+                k ^= k >> r;
+                k *= m;
+
+                h ^= k;
+                h *= m;
+            }
+
+            std::uint64_t tail = 0;
+            switch (length & 7) {
+                case 7: tail ^= static_cast<std::uint64_t>(static_cast<unsigned char>(data[6])) << 48; // fallthrough
+                case 6: tail ^= static_cast<std::uint64_t>(static_cast<unsigned char>(data[5])) << 40; // fallthrough
+                case 5: tail ^= static_cast<std::uint64_t>(static_cast<unsigned char>(data[4])) << 32; // fallthrough
+                case 4: tail ^= static_cast<std::uint64_t>(static_cast<unsigned char>(data[3])) << 24; // fallthrough
+                case 3: tail ^= static_cast<std::uint64_t>(static_cast<unsigned char>(data[2])) << 16; // fallthrough
+                case 2: tail ^= static_cast<std::uint64_t>(static_cast<unsigned char>(data[1])) << 8;  // fallthrough
+                case 1: tail ^= static_cast<std::uint64_t>(static_cast<unsigned char>(data[0]));
+                        h ^= tail;
+                        h *= m;
+            }
+
+            h ^= h >> r;
+            h *= m;
+            h ^= h >> r;
+
+            return h;
+        }
+
+        static void AppendNumber(std::string& out, unsigned long value)
+        {
+            char digits[20];
+            std::size_t length = 0;
+            do {
+                digits[length++] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value > 0);
+
+            while (length > 0) {
+                out += digits[--length];
+            }
+        }
+
+        static void AppendEscaped(std::string& out, const std::string& value)
+        {
+            static const char hex[] = "0123456789ABCDEF";
+            for (char c : value) {
+                unsigned char u = static_cast<unsigned char>(c);
+                if (std::isalnum(u) || c == '-' || c == '_' || c == '.' || c == '~') {
+                    out += c;
+                } else {
+                    out += '%';
+                    out += hex[u >> 4];
+                    out += hex[u & 0x0F];
+                }
+            }
+        }
 
         /**
-         * Mark category with an action.
-         *
-         * @param action      the action to apply
+         * Map the "All", "Uncategorized" and "Saved" pseudo categories to
+         * their stream IDs; any other ID is returned unchanged.
          */
-        void MarkCategoryAs(std::string categoryID, Category::Action action, const std::string& lastReadEntryId = "") const
+        const std::string& StreamId(const std::string& categoryId) const
+        {
+            if (categoryId == "All") {
+                return m_allStream;
+            } else if (categoryId == "Uncategorized") {
+                return m_uncategorizedStream;
+            } else if (categoryId == "Saved") {
+                return m_savedStream;
+            }
+
+            return categoryId;
+        }
+
+        std::string MarkCategoryBody(const std::string& categoryID, Category::Action action, const std::string& lastReadEntryId) const
         {
             if (categoryID.empty()) {
                 throw std::runtime_error("Category ID cannot be empty");
@@ -615,197 +2290,129 @@ class Fdly {
             }
             j["action"] = ActionToString(action);
 
-            auto r = cpr::Post(cpr::Url{m_rootUrl + "/markers"},
-                    cpr::Header{{"Authorization", "OAuth " + m_user.AuthToken},
-                                {"Content-Type", "application/json"}},
-                    cpr::Body{j.dump()});
+            return j.dump();
+        }
+
+        std::string MarkEntriesBody(const std::vector<std::string>& entryIds, Entry::Action action) const
+        {
+            json j;
+            j["type"] = "entries";
+
+            for (auto& id : entryIds) {
+                j["entryIds"].push_back(id);
+            }
+
+            j["action"] = ActionToString(action);
+
+            return j.dump();
+        }
+
+        /*
+         * The Complete and Parse functions below handle the responses of
+         * every front end, synchronous or not, so that the authentication
+         * state, caches and transfer statistics stay consistent whichever
+         * one sent the request.
+         */
+
+        void CompleteMarkCategory(const cpr::Response& r, Category::Action action) const
+        {
+            NoteAuthentication(r);
+            // Not only the category's stream: its entries also appear in the
+            // streams of their feeds, of "All" and of other categories
+            m_entriesCache.Clear();
 
             if (r.status_code not_eq 200) {
-                std::string error = "Could not mark category with " + ActionToString(action) + ": " + std::to_string(r.status_code);
+                std::string error = std::string("Could not mark category with ") + ActionToString(action) + ": " + std::to_string(r.status_code);
                 throw std::runtime_error(error.c_str());
             }
         }
 
-
-        /**
-         * Mark entry with an action.
-         *
-         * @param action  the action to apply
-         */
-        void MarkEntryAs(Entry::Action action)
+        void CompleteMarkEntries(const cpr::Response& r, const std::vector<std::string>& entryIds, Entry::Action action) const
         {
-            // TODO
+            NoteAuthentication(r);
+            m_entriesCache.InvalidateEntries(entryIds);
+
+            if (r.status_code not_eq 200) {
+                std::string error = std::string("Could not mark entries with ") + ActionToString(action) + ": " + std::to_string(r.status_code);
+                throw std::runtime_error(error.c_str());
+            }
         }
 
-        /**
-         * Mark a multiple entries with an action.
-         *
-         * @param entryId  list of IDs for the entries to apply the action to
-         * @param action  the action to apply
-         */
-        void MarkEntriesWithAction(const std::vector<std::string>& entryIds, Entry::Action action)
+        Categories ParseCategories(const cpr::Response& r, MemoryResource* resource = nullptr) const
         {
-            if (entryIds.size() > 0) {
-                json j;
-                j["type"] = "entries";
+            NoteAuthentication(r);
 
-                for (auto& id : entryIds) {
-                    j["entryIds"].push_back(id);
-                }
+            if (r.status_code not_eq 200) {
+                std::string error = "Could not get categories: " + std::to_string(r.status_code);
+                throw std::runtime_error(error.c_str());
+            }
 
-                j["action"] = ActionToString(action);
+            auto jsonResp = json::parse(DecodeBody(r));
 
-                auto r = cpr::Post(cpr::Url{m_rootUrl + "/markers"},
-                        cpr::Body{j.dump()},
-                        cpr::Header{{"Authorization", "OAuth " + m_user.AuthToken},
-                                    {"Content-Type", "application/json"}});
-                if (r.status_code not_eq 200) {
-                    std::string error = "Could not mark entries with " + ActionToString(action) + ": " + std::to_string(r.status_code);
-                    throw std::runtime_error(error.c_str());
-                }
+            Categories categories(resource);
+            for (auto& ctg : jsonResp) {
+                categories.append(Category {m_strings.Intern(ctg["label"]), m_strings.Intern(ctg["id"])});
             }
+
+            return categories;
         }
 
-        /**
-         * Get list of subscribed feeds
-         */
-        Feeds GetSubscriptions()
+        Feeds ParseSubscriptions(const cpr::Response& r, MemoryResource* resource = nullptr) const
         {
-            auto r = cpr::Get(cpr::Url{m_rootUrl + "/subscriptions"},
-                              cpr::Header{{"Authorization", "OAuth " + m_user.AuthToken}});
+            NoteAuthentication(r);
 
             if (r.status_code not_eq 200) {
                 std::string error = "Could not get subscriptions: " + std::to_string(r.status_code);
                 throw std::runtime_error(error.c_str());
             }
 
-            auto j = json::parse(r.text);
+            auto j = json::parse(DecodeBody(r));
 
-            Feeds feeds;
+            Feeds feeds(resource);
+            // Categories keep their resource when moved, not when copied or
+            // assigned, so they are built in place and never reallocated
+            feeds.reserve(j.size());
             for (const auto& feed : j) {
-                Feed tmp;
+                Feed tmp {"", "", "", "", "", 0, 0, Categories(resource)};
                 tmp.Title = feed["title"];
                 tmp.ID = feed["id"];
                 tmp.Url = feed["website"];
                 tmp.VisualUrl = feed["visualUrl"];
-                tmp.Updated = feed["updated"];
+                auto updated = feed.find("updated");
+                if (updated != feed.end() && updated->is_number()) {
+                    tmp.Updated = *updated;
+                }
+                auto added = feed.find("added");
+                if (added != feed.end() && added->is_number()) {
+                    tmp.Added = *added;
+                }
 
-                Categories ctgs {};
                 for (const auto& ctg : feed["categories"]) {
-                    Category tmp;
-                    tmp.Label = ctg["label"];
-                    tmp.ID = ctg["id"];
-                    ctgs.append(tmp);
+                    tmp.Categories.append(Category {m_strings.Intern(ctg["label"]), m_strings.Intern(ctg["id"])});
                 }
 
-                tmp.Categories = ctgs;
-
-                feeds.push_back(tmp);
+                feeds.push_back(std::move(tmp));
             }
 
             return feeds;
         }
 
-        /**
-         * Subscribe to a feed
-         *
-         * @param feed  the feed to subscribe to
-         */
-        void AddSubscription(const Feed& feed)
-        {
-            json j;
-            j["id"] = "feed/" + feed.Url;
-            j["title"] = feed.Title;
-
-            if (not feed.Categories.empty()) {
-                for (const auto& ctg : feed.Categories) {
-                    j["categories"].push_back({{"label", ctg.Label},
-                                               {"id",    ctg.ID}});
-                }
-            } else {
-                j["categories"] = json::array();
-            }
-
-            auto r = cpr::Post(cpr::Url{m_rootUrl + "/subscriptions"},
-                               cpr::Header{{"Authorization", "OAuth " + m_user.AuthToken},
-                                           {"Content-Type", "application/json"}},
-                               cpr::Body{j.dump()});
-
-            if (r.status_code not_eq 200) {
-                std::string error = "Could not add subscription: " + std::to_string(r.status_code);
-                throw std::runtime_error(error.c_str());
-            }
-        }
-
-        Entries GetEntries(
-                const Category& category,
-                bool sortByOldest = false,
-                unsigned int count = 20,
-                bool unreadOnly = true,
-                std::string continuationId = "",
-                unsigned long newerThan = 0
-                ) const
-        {
-            return GetEntries(category.ID, sortByOldest, count, unreadOnly, continuationId, newerThan);
-        }
-
-        /**
-         * Return entries for a specific category.
-         *
-         * @param categoryId     the category to fetch entries from
-         * @param sortByOldest   return the list of entries ordered by oldest
-         * @param count          number of entries to fetch
-         * @param unreadOnly     fetch only unread entries
-         * @param continuationId fetch entries after a specific id
-         * @param newerThan      fetch entries newer than timestamp in ms
-         *
-         * @return a list of entries
-         */
-        Entries GetEntries(
-                const std::string& categoryId,
-                bool sortByOldest = false,
-                unsigned int count = 20,
-                bool unreadOnly = true,
-                std::string continuationId = "",
-                unsigned long newerThan = 0
-                ) const
+        Entries ParseEntries(
+                const cpr::Response& r,
+                ContentFormat format = ContentFormat::HTML,
+                MemoryResource* resource = nullptr) const
         {
-            auto params = cpr::Parameters({
-                    {"ranked",       sortByOldest ? "oldest" : "newest"},
-                    {"unreadOnly",   unreadOnly   ? "true"   : "false" },
-                    {"count",        std::to_string(count)}
-                    });
-
-            if (not continuationId.empty()) {
-                params.AddParameter(cpr::Parameter{"continuation", continuationId});
-            }
-
-            if (newerThan > 0) {
-                params.AddParameter(cpr::Parameter{"newerThan", std::to_string(newerThan)});
-            }
-
-            if (categoryId == "All") {
-                params.AddParameter(cpr::Parameter{"streamId", "user/" + m_user.ID + "/category/global.all"});
-            } else if (categoryId == "Uncategorized") {
-                params.AddParameter(cpr::Parameter{"streamId", "user/" + m_user.ID + "/category/global.uncategorized"});
-            } else if (categoryId == "Saved") {
-                params.AddParameter(cpr::Parameter{"streamId", "user/" + m_user.ID + "/tag/global.saved"});
-            } else {
-                params.AddParameter(cpr::Parameter{"streamId", categoryId});
-            }
-
-            auto r = cpr::Get(cpr::Url{m_rootUrl + "/streams/contents"},
-                    cpr::Header{{"Authorization", "OAuth " + m_user.AuthToken}},
-                    params);
+            NoteAuthentication(r);
 
             if (r.status_code not_eq 200) {
                 std::string error = "Could not get entries: " + std::to_string(r.status_code);
                 throw std::runtime_error(error.c_str());
             }
 
-            auto j = json::parse(r.text);
+            auto j = json::parse(DecodeBody(r));
 
-            Entries entries;
+            Entries entries(resource);
+            entries.reserve(j["items"].size());
             for (auto& item : j["items"]) {
                 std::string title = item["title"];
                 std::string id = item["id"];
@@ -825,35 +2432,287 @@ class Fdly {
                         content,
                         title,
                         id,
-                        originID,
-                        originTitle
+                        m_strings.Intern(originID),
+                        m_strings.Intern(originTitle)
                         );
+
+                Entry& entry = entries.back();
+                if (item["published"].is_number()) {
+                    entry.Published = item["published"];
+                }
+                if (item["crawled"].is_number()) {
+                    entry.Crawled = item["crawled"];
+                }
+                entry.Hash = HashEntry(entry);
+
+                if (format == ContentFormat::TEXT) {
+                    entry.Text = HtmlText::Extract(entry.Content);
+                    entry.Snippet = HtmlText::Snippet(entry.Text, SnippetLength);
+                }
+            }
+
+            if (j["continuation"].is_string()) {
+                entries.setContinuation(j["continuation"]);
             }
 
             return entries;
         }
 
         /**
-         * Get a list of unread counts
+         * Idle sessions kept for reuse, so that requests made one after the
+         * other go over the same connection.
          */
-        void UnreadCounts()
+        class SessionPool {
+            public:
+                std::unique_ptr<cpr::Session> Acquire()
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_sessions.empty()) {
+                        return std::unique_ptr<cpr::Session>(new cpr::Session);
+                    }
+
+                    auto session = std::move(m_sessions.back());
+                    m_sessions.pop_back();
+                    return session;
+                }
+
+                void Release(std::unique_ptr<cpr::Session> session)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_sessions.size() < MaxIdle) {
+                        m_sessions.push_back(std::move(session));
+                    }
+                }
+
+            private:
+                static constexpr std::size_t MaxIdle = 8;
+
+                std::mutex m_mutex;
+                std::vector<std::unique_ptr<cpr::Session>> m_sessions;
+        };
+
+        /**
+         * Open a connection to the API host and leave it in the pool.
+         */
+        void WarmUp()
         {
-            //TODO
+            try {
+                auto session = m_sessions.Acquire();
+                session->SetUrl(cpr::Url{m_baseUrl});
+                session->Head();
+                m_sessions.Release(std::move(session));
+            } catch (...) {
+                // The first request will connect by itself
+            }
+        }
+
+        std::unique_ptr<cpr::Session> AcquireSession() const
+        {
+            // Take the warmed up connection rather than racing it with a
+            // second one
+            if (m_warmUp.valid()) {
+                m_warmUp.wait();
+            }
+            return m_sessions.Acquire();
+        }
+
+        cpr::Response SendGet(const std::string& url) const
+        {
+            if (m_transport) {
+                static const std::string noBody;
+                return m_transport("GET", url, AuthHeader(), noBody);
+            }
+
+            auto session = AcquireSession();
+            session->SetUrl(cpr::Url{url});
+            session->SetHeader(AuthHeader());
+
+            auto r = session->Get();
+            m_sessions.Release(std::move(session));
+            return r;
+        }
+
+        cpr::Response SendPost(const std::string& url, const std::string& body) const
+        {
+            if (m_transport) {
+                return m_transport("POST", url, AuthHeader(true), body);
+            }
+
+            auto session = AcquireSession();
+            session->SetUrl(cpr::Url{url});
+            session->SetHeader(AuthHeader(true));
+            session->SetBody(cpr::Body{body});
+
+            auto r = session->Post();
+            m_sessions.Release(std::move(session));
+            return r;
+        }
+
+        void NoteAuthentication(const cpr::Response& r) const
+        {
+            if (r.status_code == 401 || r.status_code == 403) {
+                m_authState = static_cast<int>(AuthState::INVALID);
+            } else if (r.status_code >= 200 && r.status_code < 300) {
+                m_authState = static_cast<int>(AuthState::VALID);
+            }
         }
 
         /**
-         * Check if Feedly is available
+         * Return the headers sent with every request.
          *
-         * @return true if we can reach cloud.feedly.com, false otherwise
+         * @param jsonBody  whether the request carries a JSON body
          */
-        static inline bool IsAvailable();
+        const cpr::Header& AuthHeader(bool jsonBody = false) const
+        {
+            return m_headers[jsonBody ? 1 : 0][m_compression ? 1 : 0];
+        }
 
-        static constexpr const char* FeedlyUrl = "https://cloud.feedly.com";
+        /**
+         * Build the headers of every combination of body type and
+         * compression once, at construction.
+         */
+        void BuildHeaders()
+        {
+            for (int jsonBody = 0; jsonBody < 2; jsonBody++) {
+                for (int compression = 0; compression < 2; compression++) {
+                    cpr::Header& header = m_headers[jsonBody][compression];
+                    header["Authorization"] = "OAuth " + m_user.AuthToken;
 
-        static constexpr const char* APIVersion3 = "v3";
+                    if (jsonBody) {
+                        header["Content-Type"] = "application/json";
+                    }
 
-    private:
-        inline std::string ActionToString(Entry::Action action) const
+                    if (compression) {
+#ifdef FDLY_WITH_BROTLI
+                        header["Accept-Encoding"] = "br, gzip, deflate";
+#else
+                        header["Accept-Encoding"] = "gzip, deflate";
+#endif
+                    }
+                }
+            }
+        }
+
+        /**
+         * Return the body of a response, decompressing it according to its
+         * Content-Encoding, and account for it in the transfer statistics.
+         */
+        std::string DecodeBody(const cpr::Response& r) const
+        {
+            std::string encoding;
+            auto it = r.header.find("Content-Encoding");
+            if (it != r.header.end()) {
+                encoding = it->second;
+            }
+
+            std::string body;
+            if (encoding == "gzip" || encoding == "deflate") {
+                body = Inflate(r.text);
+#ifdef FDLY_WITH_BROTLI
+            } else if (encoding == "br") {
+                body = BrotliDecode(r.text);
+#endif
+            } else if (encoding.empty() || encoding == "identity") {
+                body = r.text;
+            } else {
+                throw std::runtime_error("Unsupported response encoding: " + encoding);
+            }
+
+            m_responses++;
+            m_compressedBytes += r.text.size();
+            m_uncompressedBytes += body.size();
+
+            return body;
+        }
+
+        /**
+         * Inflate a gzip, zlib wrapped or raw deflate stream chunk by chunk.
+         * Servers disagree on whether "deflate" means the zlib wrapped or
+         * the raw format, so the format is told from the first bytes.
+         */
+        static std::string Inflate(const std::string& compressed)
+        {
+            // 15 window bits, +16 for gzip, negative for raw deflate
+            int windowBits = -15;
+            if (compressed.size() >= 2) {
+                unsigned char first = static_cast<unsigned char>(compressed[0]);
+                unsigned char second = static_cast<unsigned char>(compressed[1]);
+                if (first == 0x1f && second == 0x8b) {
+                    windowBits = 15 + 16;
+                } else if ((first & 0x0f) == Z_DEFLATED && (first >> 4) <= 7 && (first * 256 + second) % 31 == 0) {
+                    windowBits = 15;
+                }
+            }
+
+            z_stream stream {};
+            if (inflateInit2(&stream, windowBits) != Z_OK) {
+                throw std::runtime_error("Could not initialize zlib");
+            }
+
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+            stream.avail_in = static_cast<uInt>(compressed.size());
+
+            std::string out;
+            char chunk[16384];
+            int ret = Z_OK;
+            while (ret != Z_STREAM_END) {
+                stream.next_out = reinterpret_cast<Bytef*>(chunk);
+                stream.avail_out = sizeof(chunk);
+
+                ret = inflate(&stream, Z_NO_FLUSH);
+                if (ret != Z_OK && ret != Z_STREAM_END) {
+                    inflateEnd(&stream);
+                    throw std::runtime_error("Could not decompress response: " + std::to_string(ret));
+                }
+
+                out.append(chunk, sizeof(chunk) - stream.avail_out);
+
+                if (ret == Z_OK && stream.avail_in == 0 && stream.avail_out != 0) {
+                    inflateEnd(&stream);
+                    throw std::runtime_error("Could not decompress response: truncated stream");
+                }
+            }
+
+            inflateEnd(&stream);
+            return out;
+        }
+
+#ifdef FDLY_WITH_BROTLI
+        /**
+         * Decompress a brotli stream chunk by chunk.
+         */
+        static std::string BrotliDecode(const std::string& compressed)
+        {
+            BrotliDecoderState* state = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+            if (state == nullptr) {
+                throw std::runtime_error("Could not initialize brotli");
+            }
+
+            const uint8_t* nextIn = reinterpret_cast<const uint8_t*>(compressed.data());
+            size_t availIn = compressed.size();
+
+            std::string out;
+            uint8_t chunk[16384];
+            BrotliDecoderResult ret = BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
+            while (ret == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
+                uint8_t* nextOut = chunk;
+                size_t availOut = sizeof(chunk);
+
+                ret = BrotliDecoderDecompressStream(state, &availIn, &nextIn, &availOut, &nextOut, nullptr);
+                out.append(reinterpret_cast<char*>(chunk), sizeof(chunk) - availOut);
+            }
+
+            BrotliDecoderDestroyInstance(state);
+
+            if (ret != BROTLI_DECODER_RESULT_SUCCESS) {
+                throw std::runtime_error("Could not decompress response: invalid brotli stream");
+            }
+
+            return out;
+        }
+#endif
+
+        static const char* ActionToString(Entry::Action action)
         {
             switch (action) {
                 case Entry::Action::READ:
@@ -865,7 +2724,7 @@ class Fdly {
             return "";
         }
 
-        inline std::string ActionToString(Category::Action action) const
+        static const char* ActionToString(Category::Action action)
         {
             switch (action) {
                 case Category::Action::READ:
@@ -877,7 +2736,7 @@ class Fdly {
             return "";
         }
 
-        inline std::string ActionToString(Feed::Action action) const
+        static const char* ActionToString(Feed::Action action)
         {
             switch (action) {
                 case Feed::Action::READ:
@@ -891,7 +2750,42 @@ class Fdly {
 
         Fdly::User m_user;
         const std::string m_effectiveAPIVersion;
+        const std::string m_baseUrl;
         const std::string m_rootUrl;
+
+        // Request pieces that do not change over the life of the connection
+        const std::string m_profileUrl;
+        const std::string m_categoriesUrl;
+        const std::string m_subscriptionsUrl;
+        const std::string m_markersUrl;
+        const std::string m_streamsUrl;
+        const std::string m_allStream;
+        const std::string m_uncategorizedStream;
+        const std::string m_savedStream;
+        cpr::Header m_headers[2][2];
+
+        const std::function<cpr::Response(const char*, const std::string&, const cpr::Header&, const std::string&)> m_transport;
+        const bool m_lazyAuthentication;
+        mutable std::atomic<int> m_authState;
+
+        std::atomic<bool> m_compression;
+        mutable std::atomic<unsigned long long> m_responses;
+        mutable std::atomic<unsigned long long> m_compressedBytes;
+        mutable std::atomic<unsigned long long> m_uncompressedBytes;
+
+        mutable StringPool m_strings;
+
+        mutable SingleFlight<Categories> m_categoriesFlight;
+        mutable SingleFlight<Entries> m_entriesFlight;
+        mutable SingleFlight<Feeds> m_subscriptionsFlight;
+
+        FeedIndex m_subscriptionsIndex;
+
+        mutable PageCache m_entriesCache;
+
+        mutable SessionPool m_sessions;
+        // Destroyed before the pool, waiting for the warm-up to finish
+        std::shared_future<void> m_warmUp;
 };
 
 bool Fdly::IsAvailable()
@@ -0,0 +1,374 @@
+/**
+ * @file
+ * Contains the FdlyAccounts class which serves many Feedly accounts over a
+ * few shared HTTP/2 connections.
+ */
+#ifndef FDLY_ACCOUNTS_HEADER_SRC_H
+#define FDLY_ACCOUNTS_HEADER_SRC_H
+
+#include "fdly.hpp"
+#include "fdly_loop.hpp"
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @class Multi-account client
+ *
+ * Every account registered with Add gets its own credentials, but all of
+ * their requests go through one FdlyLoop whose connections to the API host
+ * are shared and multiplexed. Requests wait in a queue per account and are
+ * started round-robin across the accounts with pending work, so a single
+ * busy account cannot starve the others of the limited number of streams:
+ *
+ *     FdlyAccounts accounts;
+ *     auto alice = accounts.Add(aliceUser);
+ *     auto bob = accounts.Add(bobUser);
+ *
+ *     auto aliceEntries = accounts.GetEntries(alice, "All");
+ *     auto bobEntries = accounts.GetEntries(bob, "All");
+ *     for (const auto& entry : aliceEntries.get()) ...
+ *
+ * Results are delivered through futures, which rethrow the same exceptions
+ * the synchronous Fdly calls would throw.
+ */
+class FdlyAccounts {
+    public:
+        /**
+         * Handle of a registered account.
+         */
+        using Account = std::size_t;
+
+        /**
+         * @param connections  most connections opened to the API host
+         * @param maxInFlight  most requests in flight over all accounts
+         * @param workers      number of threads parsing responses
+         */
+        FdlyAccounts(long connections = 2, std::size_t maxInFlight = 200, unsigned int workers = 2) :
+            m_maxInFlight(maxInFlight == 0 ? 1 : maxInFlight),
+            m_inFlight(0),
+            m_nextAccount(0),
+            m_closing(false),
+            m_loop(workers, connections)
+        {
+        }
+
+        FdlyAccounts(const FdlyAccounts&) = delete;
+        FdlyAccounts& operator=(const FdlyAccounts&) = delete;
+
+        /**
+         * Fail the queued requests and wait for those in flight.
+         */
+        ~FdlyAccounts()
+        {
+            std::vector<Pending> dropped;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_closing = true;
+                for (auto& account : m_ready) {
+                    Drain(*account, dropped);
+                }
+                m_ready.clear();
+            }
+            Fail(dropped, "Client closed before the request was sent");
+        }
+
+        /**
+         * Register an account.
+         *
+         * @param user     the account credentials
+         * @param options  options of the account's connection
+         * @return handle used for the account's requests
+         */
+        Account Add(Fdly::User user, const Fdly::Options& options = Fdly::Options())
+        {
+            auto state = std::make_shared<AccountState>(user, options);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Account account = m_nextAccount++;
+            m_accounts.emplace(account, std::move(state));
+            return account;
+        }
+
+        /**
+         * Unregister an account. Its queued requests fail, those already in
+         * flight complete normally, keeping the account's state alive until
+         * they do.
+         */
+        void Remove(Account account)
+        {
+            std::vector<Pending> dropped;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                auto it = m_accounts.find(account);
+                if (it == m_accounts.end()) {
+                    return;
+                }
+                Drain(*it->second, dropped);
+                m_accounts.erase(it);
+            }
+            Fail(dropped, "Account removed before the request was sent");
+        }
+
+        /**
+         * Number of registered accounts.
+         */
+        std::size_t size() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_accounts.size();
+        }
+
+        /**
+         * Request the categories of an account.
+         */
+        std::future<Fdly::Categories> GetCategories(Account account)
+        {
+            auto state = Find(account);
+            const Fdly* api = &state->Api;
+            return Enqueue<Fdly::Categories>(state, api->m_categoriesUrl, api->AuthHeader(), nullptr,
+                    [api] (const cpr::Response& r) {
+                        return api->ParseCategories(r);
+                    });
+        }
+
+        /**
+         * Request the subscriptions of an account.
+         */
+        std::future<Fdly::Feeds> GetSubscriptions(Account account)
+        {
+            auto state = Find(account);
+            const Fdly* api = &state->Api;
+            return Enqueue<Fdly::Feeds>(state, api->m_subscriptionsUrl, api->AuthHeader(), nullptr,
+                    [api] (const cpr::Response& r) {
+                        return api->ParseSubscriptions(r);
+                    });
+        }
+
+        /**
+         * Request a page of a stream of an account. The parameters are those
+         * of Fdly::GetEntries.
+         */
+        std::future<Fdly::Entries> GetEntries(
+                Account account,
+                const std::string& categoryId,
+                bool sortByOldest = false,
+                unsigned int count = 20,
+                bool unreadOnly = true,
+                const std::string& continuationId = "",
+                unsigned long newerThan = 0,
+                Fdly::ContentFormat format = Fdly::ContentFormat::HTML)
+        {
+            auto state = Find(account);
+            const Fdly* api = &state->Api;
+            return Enqueue<Fdly::Entries>(state, api->EntriesUrl(categoryId, sortByOldest, count, unreadOnly, continuationId, newerThan),
+                    api->AuthHeader(), nullptr,
+                    [api, format] (const cpr::Response& r) {
+                        return api->ParseEntries(r, format);
+                    });
+        }
+
+        /**
+         * Mark a category of an account. The parameters are those of
+         * Fdly::MarkCategoryAs.
+         */
+        std::future<void> MarkCategoryAs(
+                Account account,
+                const std::string& categoryID,
+                Fdly::Category::Action action,
+                const std::string& lastReadEntryId = "")
+        {
+            auto state = Find(account);
+            const Fdly* api = &state->Api;
+            std::string body = api->MarkCategoryBody(categoryID, action, lastReadEntryId);
+            return Enqueue<void>(state, api->m_markersUrl, api->AuthHeader(true), &body,
+                    [api, action] (const cpr::Response& r) {
+                        api->CompleteMarkCategory(r, action);
+                    });
+        }
+
+        /**
+         * Mark entries of an account. The parameters are those of
+         * Fdly::MarkEntriesWithAction.
+         */
+        std::future<void> MarkEntriesWithAction(
+                Account account,
+                const std::vector<std::string>& entryIds,
+                Fdly::Entry::Action action)
+        {
+            auto state = Find(account);
+            const Fdly* api = &state->Api;
+            std::string body = api->MarkEntriesBody(entryIds, action);
+            return Enqueue<void>(state, api->m_markersUrl, api->AuthHeader(true), &body,
+                    [api, entryIds, action] (const cpr::Response& r) {
+                        api->CompleteMarkEntries(r, entryIds, action);
+                    });
+        }
+
+    private:
+        struct Pending {
+            std::string                               Url;
+            cpr::Header                               Header;
+            bool                                      IsPost;
+            std::string                               Body;
+            std::function<void(const cpr::Response&)> OnDone;
+            std::function<void(std::exception_ptr)>   OnFail;
+        };
+
+        struct AccountState {
+            AccountState(Fdly::User& user, const Fdly::Options& options) :
+                Api(user, options)
+            {
+            }
+
+            Fdly                Api;
+            std::deque<Pending> Queue;
+            bool                Scheduled = false;
+        };
+
+        using AccountPtr = std::shared_ptr<AccountState>;
+
+        template<class T>
+        static void Settle(std::promise<T>& promise, const std::function<T(const cpr::Response&)>& parse, const cpr::Response& r)
+        {
+            promise.set_value(parse(r));
+        }
+
+        static void Settle(std::promise<void>& promise, const std::function<void(const cpr::Response&)>& parse, const cpr::Response& r)
+        {
+            parse(r);
+            promise.set_value();
+        }
+
+        static void Fail(std::vector<Pending>& dropped, const char* reason)
+        {
+            for (auto& pending : dropped) {
+                pending.OnFail(std::make_exception_ptr(std::runtime_error(reason)));
+            }
+        }
+
+        static void Drain(AccountState& account, std::vector<Pending>& dropped)
+        {
+            for (auto& pending : account.Queue) {
+                dropped.push_back(std::move(pending));
+            }
+            account.Queue.clear();
+        }
+
+        AccountPtr Find(Account account) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_accounts.find(account);
+            if (it == m_accounts.end()) {
+                throw std::runtime_error("Unknown account");
+            }
+            return it->second;
+        }
+
+        template<class T>
+        std::future<T> Enqueue(
+                const AccountPtr& account,
+                std::string url,
+                cpr::Header header,
+                const std::string* body,
+                std::function<T(const cpr::Response&)> parse)
+        {
+            auto promise = std::make_shared<std::promise<T>>();
+            auto future = promise->get_future();
+
+            Pending pending {std::move(url), std::move(header), body != nullptr, body != nullptr ? *body : "",
+                [promise, parse] (const cpr::Response& r) {
+                    try {
+                        Settle(*promise, parse, r);
+                    } catch (...) {
+                        promise->set_exception(std::current_exception());
+                    }
+                },
+                [promise] (std::exception_ptr error) {
+                    promise->set_exception(error);
+                }};
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closing) {
+                throw std::runtime_error("Request submitted to a closing client");
+            }
+            account->Queue.push_back(std::move(pending));
+            if (not account->Scheduled) {
+                account->Scheduled = true;
+                m_ready.push_back(account);
+            }
+            Pump();
+            return future;
+        }
+
+        /**
+         * Start queued requests, one per account in turn, until the in-flight
+         * limit is reached. Must be called with m_mutex held.
+         */
+        void Pump()
+        {
+            while (not m_closing && m_inFlight < m_maxInFlight && not m_ready.empty()) {
+                AccountPtr account = std::move(m_ready.front());
+                m_ready.pop_front();
+                if (account->Queue.empty()) {
+                    // Removed while waiting for its turn
+                    account->Scheduled = false;
+                    continue;
+                }
+
+                auto pending = std::make_shared<Pending>(std::move(account->Queue.front()));
+                account->Queue.pop_front();
+                if (account->Queue.empty()) {
+                    account->Scheduled = false;
+                } else {
+                    m_ready.push_back(account);
+                }
+
+                // The parsers only hold a pointer to the account's connection,
+                // so the account lives until its response is handled even if
+                // it is removed in the meantime
+                auto done = [this, pending, account] (cpr::Response r) {
+                    {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        m_inFlight--;
+                        Pump();
+                    }
+                    pending->OnDone(r);
+                };
+
+                m_inFlight++;
+                try {
+                    if (pending->IsPost) {
+                        m_loop.Post(pending->Url, pending->Header, pending->Body, std::move(done));
+                    } else {
+                        m_loop.Get(pending->Url, pending->Header, std::move(done));
+                    }
+                } catch (...) {
+                    m_inFlight--;
+                    pending->OnFail(std::current_exception());
+                }
+            }
+        }
+
+        mutable std::mutex m_mutex;
+        std::unordered_map<Account, AccountPtr> m_accounts;
+        std::deque<AccountPtr> m_ready;
+        std::size_t m_maxInFlight;
+        std::size_t m_inFlight;
+        Account m_nextAccount;
+        bool m_closing;
+
+        // Declared last so that it is destroyed first, while the state its
+        // completion callbacks use is still alive
+        FdlyLoop m_loop;
+};
+
+#endif /* ifndef FDLY_ACCOUNTS_HEADER_SRC_H */
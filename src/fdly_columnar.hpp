@@ -0,0 +1,391 @@
+/**
+ * @file
+ * Contains the EntriesSnapshot class, a columnar copy of entries that can be
+ * saved to and memory-mapped from a file.
+ */
+#ifndef FDLY_COLUMNAR_HEADER_SRC_H
+#define FDLY_COLUMNAR_HEADER_SRC_H
+
+#include "fdly.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FDLY_HAS_MMAP 1
+#endif
+
+/**
+ * @class Struct-of-arrays snapshot of entries
+ *
+ * Each string field is stored as one contiguous byte buffer with an offsets
+ * array, and each timestamp field as a plain array, all in a single buffer
+ * laid out exactly as the snapshot file. Loading a file therefore only maps
+ * it; the columns point straight into the mapping.
+ *
+ * Files use the host's byte order. Loading checks that every offset stays
+ * within its column, so a corrupt file is rejected rather than read out of
+ * bounds; this touches the offsets but not the string bytes.
+ */
+class EntriesSnapshot {
+    private:
+        enum StringField { IDField, TitleField, OriginURLField, OriginTitleField, ContentField, StringColumns };
+        enum TimestampField { PublishedField, CrawledField, TimestampColumns };
+
+        static constexpr const char* Magic = "FDLYCOL1";
+
+        struct Header {
+            char          Magic[8];
+            std::uint64_t Count;
+            std::uint64_t StringColumns;
+            std::uint64_t TimestampColumns;
+        };
+
+        static std::size_t Pad(std::size_t size)
+        {
+            return (size + 7) & ~static_cast<std::size_t>(7);
+        }
+
+    public:
+        /**
+         * A string stored in a column, valid as long as its snapshot.
+         */
+        struct StringRef {
+            const char* Data;
+            std::size_t Size;
+
+            std::string str() const
+            {
+                return std::string(Data, Size);
+            }
+
+            bool operator==(const std::string& other) const
+            {
+                return Size == other.size() && std::memcmp(Data, other.data(), Size) == 0;
+            }
+        };
+
+        /**
+         * One string field of every entry.
+         */
+        class StringColumn {
+            public:
+                StringColumn(const std::uint64_t* offsets, const char* bytes, std::size_t count) :
+                    m_offsets(offsets),
+                    m_bytes(bytes),
+                    m_count(count)
+                {
+                }
+
+                StringRef operator[](std::size_t index) const
+                {
+                    return StringRef {m_bytes + m_offsets[index],
+                                      static_cast<std::size_t>(m_offsets[index + 1] - m_offsets[index])};
+                }
+
+                std::size_t size() const
+                {
+                    return m_count;
+                }
+
+                /**
+                 * All values back to back, for scans over the whole column.
+                 */
+                const char* bytes() const
+                {
+                    return m_bytes;
+                }
+
+                /**
+                 * size() + 1 offsets into bytes(); value i spans
+                 * [offsets()[i], offsets()[i + 1]).
+                 */
+                const std::uint64_t* offsets() const
+                {
+                    return m_offsets;
+                }
+
+            private:
+                const std::uint64_t* m_offsets;
+                const char* m_bytes;
+                std::size_t m_count;
+        };
+
+        /**
+         * One timestamp field of every entry, in ms since the epoch.
+         */
+        class TimestampColumn {
+            public:
+                TimestampColumn(const std::int64_t* values, std::size_t count) :
+                    m_values(values),
+                    m_count(count)
+                {
+                }
+
+                std::int64_t operator[](std::size_t index) const
+                {
+                    return m_values[index];
+                }
+
+                const std::int64_t* data() const
+                {
+                    return m_values;
+                }
+
+                std::size_t size() const
+                {
+                    return m_count;
+                }
+
+            private:
+                const std::int64_t* m_values;
+                std::size_t m_count;
+        };
+
+        /**
+         * Accumulates entries, page after page, into a snapshot.
+         */
+        class Builder {
+            public:
+                void Append(const Fdly::Entry& entry)
+                {
+                    m_strings[IDField].Append(entry.ID);
+                    m_strings[TitleField].Append(entry.Title);
+                    m_strings[OriginURLField].Append(entry.OriginURL.str());
+                    m_strings[OriginTitleField].Append(entry.OriginTitle.str());
+                    m_strings[ContentField].Append(entry.Content);
+                    m_timestamps[PublishedField].push_back(entry.Published);
+                    m_timestamps[CrawledField].push_back(entry.Crawled);
+                    m_count++;
+                }
+
+                void Append(const Fdly::Entries& entries)
+                {
+                    for (const auto& entry : entries) {
+                        Append(entry);
+                    }
+                }
+
+                EntriesSnapshot Build() const
+                {
+                    std::size_t size = sizeof(Header);
+                    for (const auto& column : m_strings) {
+                        size += (m_count + 1) * sizeof(std::uint64_t) + Pad(column.Bytes.size());
+                    }
+                    size += TimestampColumns * m_count * sizeof(std::int64_t);
+
+                    std::shared_ptr<char> buffer(new char[size](), std::default_delete<char[]>());
+                    char* p = buffer.get();
+
+                    Header header {};
+                    std::memcpy(header.Magic, Magic, sizeof(header.Magic));
+                    header.Count = m_count;
+                    header.StringColumns = StringColumns;
+                    header.TimestampColumns = TimestampColumns;
+                    std::memcpy(p, &header, sizeof(header));
+                    p += sizeof(header);
+
+                    for (const auto& column : m_strings) {
+                        std::memcpy(p, column.Offsets.data(), column.Offsets.size() * sizeof(std::uint64_t));
+                        p += column.Offsets.size() * sizeof(std::uint64_t);
+                        if (not column.Bytes.empty()) {
+                            std::memcpy(p, column.Bytes.data(), column.Bytes.size());
+                        }
+                        p += Pad(column.Bytes.size());
+                    }
+
+                    for (const auto& column : m_timestamps) {
+                        if (not column.empty()) {
+                            std::memcpy(p, column.data(), column.size() * sizeof(std::int64_t));
+                        }
+                        p += column.size() * sizeof(std::int64_t);
+                    }
+
+                    return EntriesSnapshot(buffer, size);
+                }
+
+            private:
+                struct Column {
+                    std::vector<std::uint64_t> Offsets {0};
+                    std::vector<char> Bytes;
+
+                    void Append(const std::string& value)
+                    {
+                        Bytes.insert(Bytes.end(), value.begin(), value.end());
+                        Offsets.push_back(Bytes.size());
+                    }
+                };
+
+                Column m_strings[StringColumns];
+                std::vector<std::int64_t> m_timestamps[TimestampColumns];
+                std::size_t m_count = 0;
+        };
+
+        /**
+         * Build a snapshot of a single page of entries.
+         */
+        static EntriesSnapshot FromEntries(const Fdly::Entries& entries)
+        {
+            Builder builder;
+            builder.Append(entries);
+            return builder.Build();
+        }
+
+        /**
+         * Load a snapshot file, memory-mapping it where supported.
+         *
+         * @param path  the file written by Write()
+         */
+        static EntriesSnapshot Map(const std::string& path)
+        {
+#ifdef FDLY_HAS_MMAP
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("Could not open snapshot: " + path);
+            }
+
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+                ::close(fd);
+                throw std::runtime_error("Could not read snapshot: " + path);
+            }
+
+            std::size_t size = static_cast<std::size_t>(st.st_size);
+            void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED) {
+                throw std::runtime_error("Could not map snapshot: " + path);
+            }
+
+            std::shared_ptr<char> buffer(static_cast<char*>(mapping), [size] (char* p) { ::munmap(p, size); });
+            return EntriesSnapshot(buffer, size);
+#else
+            std::FILE* file = std::fopen(path.c_str(), "rb");
+            if (file == nullptr) {
+                throw std::runtime_error("Could not open snapshot: " + path);
+            }
+
+            std::fseek(file, 0, SEEK_END);
+            long length = std::ftell(file);
+            std::fseek(file, 0, SEEK_SET);
+            if (length <= 0) {
+                std::fclose(file);
+                throw std::runtime_error("Could not read snapshot: " + path);
+            }
+
+            std::size_t size = static_cast<std::size_t>(length);
+            std::shared_ptr<char> buffer(new char[size], std::default_delete<char[]>());
+            std::size_t read = std::fread(buffer.get(), 1, size, file);
+            std::fclose(file);
+            if (read != size) {
+                throw std::runtime_error("Could not read snapshot: " + path);
+            }
+
+            return EntriesSnapshot(buffer, size);
+#endif
+        }
+
+        /**
+         * Save the snapshot to a file.
+         */
+        void Write(const std::string& path) const
+        {
+            std::FILE* file = std::fopen(path.c_str(), "wb");
+            if (file == nullptr) {
+                throw std::runtime_error("Could not create snapshot: " + path);
+            }
+
+            std::size_t written = std::fwrite(m_buffer.get(), 1, m_size, file);
+            bool closed = std::fclose(file) == 0;
+            if (written != m_size || not closed) {
+                throw std::runtime_error("Could not write snapshot: " + path);
+            }
+        }
+
+        std::size_t size() const { return m_count; }
+        bool empty() const { return m_count == 0; }
+
+        const StringColumn& IDs() const          { return m_columns[IDField]; }
+        const StringColumn& Titles() const       { return m_columns[TitleField]; }
+        const StringColumn& OriginURLs() const   { return m_columns[OriginURLField]; }
+        const StringColumn& OriginTitles() const { return m_columns[OriginTitleField]; }
+        const StringColumn& Contents() const     { return m_columns[ContentField]; }
+        const TimestampColumn& Published() const { return m_timestamps[PublishedField]; }
+        const TimestampColumn& Crawled() const   { return m_timestamps[CrawledField]; }
+
+    private:
+        EntriesSnapshot(std::shared_ptr<char> buffer, std::size_t size) :
+            m_buffer(std::move(buffer)),
+            m_size(size)
+        {
+            const char* p = m_buffer.get();
+            const char* end = p + m_size;
+
+            Header header;
+            if (m_size < sizeof(header)) {
+                throw std::runtime_error("Invalid snapshot: truncated header");
+            }
+            std::memcpy(&header, p, sizeof(header));
+            if (std::memcmp(header.Magic, Magic, sizeof(header.Magic)) != 0
+                    || header.StringColumns != StringColumns
+                    || header.TimestampColumns != TimestampColumns) {
+                throw std::runtime_error("Invalid snapshot: unknown format");
+            }
+            p += sizeof(header);
+
+            // Every column holds at least Count + 1 offsets of 8 bytes, which
+            // also keeps the sizes below from overflowing
+            if (header.Count >= static_cast<std::size_t>(end - p) / sizeof(std::uint64_t)) {
+                throw std::runtime_error("Invalid snapshot: truncated column");
+            }
+            m_count = static_cast<std::size_t>(header.Count);
+
+            for (int i = 0; i < StringColumns; i++) {
+                std::size_t offsetsSize = (m_count + 1) * sizeof(std::uint64_t);
+                if (static_cast<std::size_t>(end - p) < offsetsSize) {
+                    throw std::runtime_error("Invalid snapshot: truncated column");
+                }
+                const std::uint64_t* offsets = reinterpret_cast<const std::uint64_t*>(p);
+                p += offsetsSize;
+
+                std::uint64_t bytes = offsets[m_count];
+                if (bytes > static_cast<std::size_t>(end - p) || Pad(bytes) > static_cast<std::size_t>(end - p)) {
+                    throw std::runtime_error("Invalid snapshot: truncated column");
+                }
+                if (offsets[0] != 0) {
+                    throw std::runtime_error("Invalid snapshot: corrupt offsets");
+                }
+                for (std::size_t j = 0; j < m_count; j++) {
+                    if (offsets[j] > offsets[j + 1]) {
+                        throw std::runtime_error("Invalid snapshot: corrupt offsets");
+                    }
+                }
+
+                m_columns.emplace_back(offsets, p, m_count);
+                p += Pad(bytes);
+            }
+
+            for (int i = 0; i < TimestampColumns; i++) {
+                std::size_t valuesSize = m_count * sizeof(std::int64_t);
+                if (static_cast<std::size_t>(end - p) < valuesSize) {
+                    throw std::runtime_error("Invalid snapshot: truncated column");
+                }
+                m_timestamps.emplace_back(reinterpret_cast<const std::int64_t*>(p), m_count);
+                p += valuesSize;
+            }
+        }
+
+        std::shared_ptr<char> m_buffer;
+        std::size_t m_size;
+        std::size_t m_count;
+        std::vector<StringColumn> m_columns;
+        std::vector<TimestampColumn> m_timestamps;
+};
+
+#endif /* ifndef FDLY_COLUMNAR_HEADER_SRC_H */
@@ -0,0 +1,482 @@
+/**
+ * @file
+ * Contains the FdlyAsync class which exposes the Feedly API as awaitable
+ * operations for C++20 coroutines.
+ *
+ * This header is opt-in and compiles to nothing unless the compiler supports
+ * coroutines.
+ */
+#ifndef FDLY_CORO_HEADER_SRC_H
+#define FDLY_CORO_HEADER_SRC_H
+
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#define FDLY_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifdef FDLY_HAS_COROUTINES
+
+#include "fdly.hpp"
+#include "fdly_loop.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+
+/**
+ * @class Awaitable interface to the Feedly API
+ *
+ * Operations are performed on a FdlyLoop and resume the awaiting coroutine on
+ * one of the loop's workers once the response has been parsed:
+ *
+ *     FdlyAsync::Task<void> Sync(FdlyAsync& api)
+ *     {
+ *         auto categories = co_await api.Categories();
+ *         for (const auto& ctg : categories) {
+ *             auto entries = co_await api.Entries(ctg);
+ *             ...
+ *             co_await api.MarkCategoryAs(ctg.ID, Fdly::Category::Action::READ);
+ *         }
+ *     }
+ *
+ *     FdlyAsync::SyncWait(Sync(api));
+ */
+class FdlyAsync {
+    private:
+        template<class T>
+        struct Result {
+            std::optional<T> Value;
+            std::exception_ptr Error;
+
+            template<class F>
+            void Capture(F&& produce)
+            {
+                try {
+                    Value.emplace(produce());
+                } catch (...) {
+                    Error = std::current_exception();
+                }
+            }
+
+            T Take()
+            {
+                if (Error) {
+                    std::rethrow_exception(Error);
+                }
+                return std::move(*Value);
+            }
+        };
+
+        template<class T>
+        struct ValuePromise {
+            Result<T> Outcome;
+
+            void return_value(T value)
+            {
+                Outcome.Value.emplace(std::move(value));
+            }
+        };
+
+        struct VoidPromise {
+            Result<bool> Outcome;
+
+            void return_void()
+            {
+                Outcome.Value.emplace(true);
+            }
+        };
+
+        /**
+         * Fire and forget coroutine used to start tasks from plain code.
+         */
+        struct Detached {
+            struct promise_type {
+                Detached get_return_object() { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }
+            };
+        };
+
+    public:
+        /**
+         * Lazily started coroutine producing a T.
+         */
+        template<class T>
+        class Task {
+            public:
+                struct promise_type : std::conditional_t<std::is_void<T>::value, VoidPromise, ValuePromise<T>> {
+                    std::coroutine_handle<> Continuation;
+
+                    Task get_return_object()
+                    {
+                        return Task {std::coroutine_handle<promise_type>::from_promise(*this)};
+                    }
+
+                    std::suspend_always initial_suspend() noexcept { return {}; }
+
+                    struct FinalAwaiter {
+                        bool await_ready() noexcept { return false; }
+
+                        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+                        {
+                            if (h.promise().Continuation) {
+                                return h.promise().Continuation;
+                            }
+                            return std::noop_coroutine();
+                        }
+
+                        void await_resume() noexcept {}
+                    };
+
+                    FinalAwaiter final_suspend() noexcept { return {}; }
+
+                    void unhandled_exception()
+                    {
+                        this->Outcome.Error = std::current_exception();
+                    }
+                };
+
+                Task(Task&& other) noexcept :
+                    m_handle(std::exchange(other.m_handle, nullptr))
+                {
+                }
+
+                Task(const Task&) = delete;
+                Task& operator=(const Task&) = delete;
+
+                ~Task()
+                {
+                    if (m_handle) {
+                        m_handle.destroy();
+                    }
+                }
+
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    m_handle.promise().Continuation = awaiting;
+                    return m_handle;
+                }
+
+                T await_resume()
+                {
+                    if constexpr (std::is_void<T>::value) {
+                        m_handle.promise().Outcome.Take();
+                    } else {
+                        return m_handle.promise().Outcome.Take();
+                    }
+                }
+
+            private:
+                explicit Task(std::coroutine_handle<promise_type> handle) :
+                    m_handle(handle)
+                {
+                }
+
+                std::coroutine_handle<promise_type> m_handle;
+        };
+
+        /**
+         * A single API request, sent when awaited.
+         */
+        template<class T>
+        class Request {
+            public:
+                using Parser = std::function<T(const cpr::Response&)>;
+
+                Request(FdlyLoop& loop, std::string url, cpr::Header header, const std::string* body, Parser parse) :
+                    m_loop(loop),
+                    m_url(std::move(url)),
+                    m_header(std::move(header)),
+                    m_isPost(body != nullptr),
+                    m_body(body != nullptr ? *body : ""),
+                    m_parse(std::move(parse))
+                {
+                }
+
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                void await_suspend(std::coroutine_handle<> awaiting)
+                {
+                    auto done = [this, awaiting] (cpr::Response r) {
+                        if constexpr (std::is_void<T>::value) {
+                            m_outcome.Capture([&] { m_parse(r); return true; });
+                        } else {
+                            m_outcome.Capture([&] { return m_parse(r); });
+                        }
+                        awaiting.resume();
+                    };
+
+                    // The coroutine may be resumed on another thread before
+                    // these return, so nothing may touch this afterwards
+                    if (m_isPost) {
+                        m_loop.Post(m_url, m_header, m_body, std::move(done));
+                    } else {
+                        m_loop.Get(m_url, m_header, std::move(done));
+                    }
+                }
+
+                T await_resume()
+                {
+                    if constexpr (std::is_void<T>::value) {
+                        m_outcome.Take();
+                    } else {
+                        return m_outcome.Take();
+                    }
+                }
+
+            private:
+                FdlyLoop& m_loop;
+                std::string m_url;
+                cpr::Header m_header;
+                bool m_isPost;
+                std::string m_body;
+                Parser m_parse;
+                Result<std::conditional_t<std::is_void<T>::value, bool, T>> m_outcome;
+        };
+
+        /**
+         * Construct an awaitable interface over an existing connection.
+         *
+         * @param fdly  connection providing the credentials and parsing
+         * @param loop  loop performing the requests
+         */
+        FdlyAsync(const Fdly& fdly, FdlyLoop& loop) :
+            m_fdly(fdly),
+            m_loop(loop)
+        {
+        }
+
+        /**
+         * Awaitable version of Fdly::GetCategories.
+         */
+        Request<Fdly::Categories> Categories() const
+        {
+            const Fdly* fdly = &m_fdly;
+            return Request<Fdly::Categories>(m_loop, m_fdly.m_categoriesUrl, m_fdly.AuthHeader(), nullptr,
+                    [fdly] (const cpr::Response& r) { return fdly->ParseCategories(r); });
+        }
+
+        /**
+         * Awaitable version of Fdly::GetSubscriptions.
+         */
+        Request<Fdly::Feeds> Subscriptions() const
+        {
+            const Fdly* fdly = &m_fdly;
+            return Request<Fdly::Feeds>(m_loop, m_fdly.m_subscriptionsUrl, m_fdly.AuthHeader(), nullptr,
+                    [fdly] (const cpr::Response& r) { return fdly->ParseSubscriptions(r); });
+        }
+
+        /**
+         * Awaitable version of Fdly::GetEntries.
+         */
+        Request<Fdly::Entries> Entries(
+                const Fdly::Category& category,
+                bool sortByOldest = false,
+                unsigned int count = 20,
+                bool unreadOnly = true,
+                const std::string& continuationId = "",
+                unsigned long newerThan = 0) const
+        {
+            return Entries(category.ID, sortByOldest, count, unreadOnly, continuationId, newerThan);
+        }
+
+        /**
+         * Awaitable version of Fdly::GetEntries.
+         */
+        Request<Fdly::Entries> Entries(
+                const std::string& categoryId,
+                bool sortByOldest = false,
+                unsigned int count = 20,
+                bool unreadOnly = true,
+                const std::string& continuationId = "",
+                unsigned long newerThan = 0) const
+        {
+            const Fdly* fdly = &m_fdly;
+            return Request<Fdly::Entries>(m_loop, m_fdly.EntriesUrl(categoryId, sortByOldest, count, unreadOnly, continuationId, newerThan),
+                    m_fdly.AuthHeader(), nullptr,
+                    [fdly] (const cpr::Response& r) { return fdly->ParseEntries(r); });
+        }
+
+        /**
+         * Awaitable version of Fdly::MarkCategoryAs.
+         */
+        Request<void> MarkCategoryAs(
+                const std::string& categoryID,
+                Fdly::Category::Action action,
+                const std::string& lastReadEntryId = "") const
+        {
+            const Fdly* fdly = &m_fdly;
+            std::string body = m_fdly.MarkCategoryBody(categoryID, action, lastReadEntryId);
+            return Request<void>(m_loop, m_fdly.m_markersUrl, m_fdly.AuthHeader(true), &body,
+                    [fdly, action] (const cpr::Response& r) { fdly->CompleteMarkCategory(r, action); });
+        }
+
+        /**
+         * Awaitable version of Fdly::MarkEntriesWithAction.
+         */
+        Request<void> MarkEntriesWithAction(const std::vector<std::string>& entryIds, Fdly::Entry::Action action) const
+        {
+            const Fdly* fdly = &m_fdly;
+            std::string body = m_fdly.MarkEntriesBody(entryIds, action);
+            return Request<void>(m_loop, m_fdly.m_markersUrl, m_fdly.AuthHeader(true), &body,
+                    [fdly, entryIds, action] (const cpr::Response& r) { fdly->CompleteMarkEntries(r, entryIds, action); });
+        }
+
+        /**
+         * Run every task concurrently and collect their results in order.
+         *
+         * If any task fails, the first failure is rethrown once all of them
+         * have completed.
+         */
+        template<class T>
+        static Task<std::conditional_t<std::is_void<T>::value, void, std::vector<T>>> WhenAll(std::vector<Task<T>> tasks)
+        {
+            using Slot = std::conditional_t<std::is_void<T>::value, bool, T>;
+
+            struct State {
+                std::atomic<std::size_t> Remaining;
+                std::coroutine_handle<> Parent;
+                std::vector<Result<Slot>> Results;
+            };
+
+            struct Awaiter {
+                std::vector<Task<T>>& Tasks;
+                State& Shared;
+
+                bool await_ready() const noexcept
+                {
+                    return Tasks.empty();
+                }
+
+                bool await_suspend(std::coroutine_handle<> parent)
+                {
+                    Shared.Parent = parent;
+                    // One extra count so the parent cannot be resumed before
+                    // every child has been started
+                    Shared.Remaining = Tasks.size() + 1;
+                    for (std::size_t i = 0; i < Tasks.size(); i++) {
+                        RunChild(Tasks[i], Shared, i);
+                    }
+                    return --Shared.Remaining != 0;
+                }
+
+                void await_resume() noexcept {}
+
+                static Detached RunChild(Task<T>& task, State& shared, std::size_t index)
+                {
+                    if constexpr (std::is_void<T>::value) {
+                        try {
+                            co_await task;
+                            shared.Results[index].Value.emplace(true);
+                        } catch (...) {
+                            shared.Results[index].Error = std::current_exception();
+                        }
+                    } else {
+                        try {
+                            shared.Results[index].Value.emplace(co_await task);
+                        } catch (...) {
+                            shared.Results[index].Error = std::current_exception();
+                        }
+                    }
+
+                    if (--shared.Remaining == 0) {
+                        shared.Parent.resume();
+                    }
+                }
+            };
+
+            State state;
+            state.Results.resize(tasks.size());
+            co_await Awaiter {tasks, state};
+
+            if constexpr (std::is_void<T>::value) {
+                for (auto& result : state.Results) {
+                    result.Take();
+                }
+            } else {
+                std::vector<T> values;
+                values.reserve(state.Results.size());
+                for (auto& result : state.Results) {
+                    values.push_back(result.Take());
+                }
+                co_return values;
+            }
+        }
+
+        /**
+         * Block the calling thread until a task has completed.
+         *
+         * @return the task's result
+         */
+        template<class T>
+        static T SyncWait(Task<T> task)
+        {
+            using Slot = std::conditional_t<std::is_void<T>::value, bool, T>;
+
+            struct State {
+                std::mutex Mutex;
+                std::condition_variable Done;
+                bool Finished = false;
+                Result<Slot> Outcome;
+            };
+
+            struct Runner {
+                static Detached Run(Task<T>& task, State& state)
+                {
+                    if constexpr (std::is_void<T>::value) {
+                        try {
+                            co_await task;
+                            state.Outcome.Value.emplace(true);
+                        } catch (...) {
+                            state.Outcome.Error = std::current_exception();
+                        }
+                    } else {
+                        try {
+                            state.Outcome.Value.emplace(co_await task);
+                        } catch (...) {
+                            state.Outcome.Error = std::current_exception();
+                        }
+                    }
+
+                    std::lock_guard<std::mutex> lock(state.Mutex);
+                    state.Finished = true;
+                    state.Done.notify_all();
+                }
+            };
+
+            State state;
+            Runner::Run(task, state);
+
+            std::unique_lock<std::mutex> lock(state.Mutex);
+            state.Done.wait(lock, [&] { return state.Finished; });
+
+            if constexpr (std::is_void<T>::value) {
+                state.Outcome.Take();
+            } else {
+                return state.Outcome.Take();
+            }
+        }
+
+    private:
+        const Fdly& m_fdly;
+        FdlyLoop& m_loop;
+};
+
+#endif /* ifdef FDLY_HAS_COROUTINES */
+
+#endif /* ifndef FDLY_CORO_HEADER_SRC_H */
@@ -0,0 +1,460 @@
+/**
+ * @file
+ * Contains the HtmlText class which extracts plain text from the HTML content
+ * of entries.
+ */
+#ifndef FDLY_HTML_HEADER_SRC_H
+#define FDLY_HTML_HEADER_SRC_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @class Fast HTML to plain text conversion
+ *
+ * Tags are dropped, the content of script and style elements is skipped,
+ * numeric character references and the named ones of Latin-1 and general
+ * punctuation are decoded, and runs of whitespace collapse to a single
+ * space. A '<' that does not start markup is kept as text. Text between
+ * markup is found 16 bytes at a time with SSE2 when available, and
+ * byte by byte otherwise.
+ */
+class HtmlText {
+    public:
+        /**
+         * Return the text content of an HTML fragment.
+         */
+        static std::string Extract(const std::string& html)
+        {
+            return ExtractWith<true>(html);
+        }
+
+        /**
+         * Same as Extract, scanning byte by byte even where SIMD is
+         * available. Meant for checking and measuring the vectorized scan.
+         */
+        static std::string ExtractScalar(const std::string& html)
+        {
+            return ExtractWith<false>(html);
+        }
+
+        /**
+         * Shorten text to at most maxLength bytes, cutting at a word
+         * boundary and never inside a UTF-8 sequence. Shortened text ends
+         * with an ellipsis, included in maxLength.
+         */
+        static std::string Snippet(const std::string& text, std::size_t maxLength)
+        {
+            if (text.size() <= maxLength) {
+                return text;
+            }
+
+            static const char ellipsis[] = "\xE2\x80\xA6";
+            const std::size_t ellipsisLength = sizeof(ellipsis) - 1;
+            if (maxLength < ellipsisLength) {
+                return "";
+            }
+
+            std::size_t cut = maxLength - ellipsisLength;
+            while (cut > 0 && (static_cast<unsigned char>(text[cut]) & 0xC0) == 0x80) {
+                cut--;
+            }
+
+            std::size_t space = text.rfind(' ', cut);
+            if (space != std::string::npos && space > cut / 2) {
+                cut = space;
+            }
+
+            while (cut > 0 && text[cut - 1] == ' ') {
+                cut--;
+            }
+
+            return text.substr(0, cut) + ellipsis;
+        }
+
+    private:
+        template<bool Vectorized>
+        static std::string ExtractWith(const std::string& html)
+        {
+            std::string out;
+            out.reserve(html.size());
+
+            const char* p = html.data();
+            const char* end = p + html.size();
+
+            while (p < end) {
+                // Leading whitespace and runs of it are dropped
+                if (static_cast<unsigned char>(*p) <= ' ' && (out.empty() || out.back() == ' ')) {
+                    p++;
+                    continue;
+                }
+
+                const char* special = FindSpecial<Vectorized>(p, end);
+                out.append(p, special);
+                p = special;
+
+                if (p == end) {
+                    break;
+                }
+
+                if (*p == '<') {
+                    if (StartsMarkup(p, end)) {
+                        p = SkipTag(p, end, out);
+                    } else {
+                        out += '<';
+                        p++;
+                    }
+                } else if (*p == '&') {
+                    p = DecodeReference(p, end, out);
+                } else {
+                    AppendSpace(out);
+                    p++;
+                }
+            }
+
+            if (not out.empty() && out.back() == ' ') {
+                out.pop_back();
+            }
+
+            return out;
+        }
+
+        /**
+         * Return the first byte at or after p that is markup or whitespace
+         * other than a single space between words.
+         */
+        template<bool Vectorized>
+        static const char* FindSpecial(const char* p, const char* end)
+        {
+#if defined(__SSE2__)
+            const __m128i lt = _mm_set1_epi8('<');
+            const __m128i amp = _mm_set1_epi8('&');
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i control = _mm_set1_epi8(' ' - 1);
+
+            // One byte of lookahead to tell single spaces from runs
+            while (Vectorized && end - p >= 17) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+
+                __m128i blank = _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk);
+                __m128i markup = _mm_or_si128(_mm_cmpeq_epi8(chunk, lt), _mm_cmpeq_epi8(chunk, amp));
+                __m128i spaces = _mm_and_si128(_mm_cmpeq_epi8(chunk, space),
+                                               _mm_cmpeq_epi8(_mm_min_epu8(next, space), next));
+
+                int mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(blank, markup), spaces));
+                if (mask != 0) {
+                    return p + __builtin_ctz(static_cast<unsigned int>(mask));
+                }
+                p += 16;
+            }
+#endif
+            while (p < end && not IsSpecial(p, end)) {
+                p++;
+            }
+            return p;
+        }
+
+        static bool IsSpecial(const char* p, const char* end)
+        {
+            unsigned char c = static_cast<unsigned char>(*p);
+            if (c == ' ') {
+                return p + 1 < end && static_cast<unsigned char>(p[1]) <= ' ';
+            }
+            return c == '<' || c == '&' || c < ' ';
+        }
+
+        /**
+         * Whether the '<' at p opens a tag, an end tag, a comment, a
+         * declaration or a processing instruction.
+         */
+        static bool StartsMarkup(const char* p, const char* end)
+        {
+            if (end - p < 2) {
+                return false;
+            }
+            char c = p[1];
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '/' || c == '!' || c == '?';
+        }
+
+        static void AppendSpace(std::string& out)
+        {
+            if (not out.empty() && out.back() != ' ') {
+                out += ' ';
+            }
+        }
+
+        static bool StartsWithNoCase(const char* p, const char* end, const char* prefix)
+        {
+            std::size_t length = std::strlen(prefix);
+            if (static_cast<std::size_t>(end - p) < length) {
+                return false;
+            }
+            for (std::size_t i = 0; i < length; i++) {
+                char c = p[i];
+                if (c >= 'A' && c <= 'Z') {
+                    c = static_cast<char>(c - 'A' + 'a');
+                }
+                if (c != prefix[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static const char* Find(const char* p, const char* end, const char* needle)
+        {
+            std::size_t length = std::strlen(needle);
+            while (p < end) {
+                const char* hit = static_cast<const char*>(std::memchr(p, needle[0], end - p));
+                if (hit == nullptr || static_cast<std::size_t>(end - hit) < length) {
+                    return end;
+                }
+                if (std::memcmp(hit, needle, length) == 0) {
+                    return hit;
+                }
+                p = hit + 1;
+            }
+            return end;
+        }
+
+        /**
+         * Skip everything from the end of a raw text element's start tag up
+         * to and including its end tag.
+         */
+        static const char* SkipRawText(const char* p, const char* end, const char* closing)
+        {
+            while (p < end) {
+                const char* lt = static_cast<const char*>(std::memchr(p, '<', end - p));
+                if (lt == nullptr) {
+                    return end;
+                }
+                if (StartsWithNoCase(lt, end, closing)) {
+                    const char* gt = static_cast<const char*>(std::memchr(lt, '>', end - lt));
+                    return gt == nullptr ? end : gt + 1;
+                }
+                p = lt + 1;
+            }
+            return end;
+        }
+
+        /**
+         * Return the '>' closing the tag opened at p, or end. A '>' inside
+         * a quoted attribute value does not close the tag.
+         */
+        static const char* FindTagEnd(const char* p, const char* end)
+        {
+            bool afterEquals = false;
+            for (p++; p < end; p++) {
+                char c = *p;
+                if (c == '>') {
+                    return p;
+                }
+                if ((c == '"' || c == '\'') && afterEquals) {
+                    const char* close = static_cast<const char*>(std::memchr(p + 1, c, end - p - 1));
+                    if (close == nullptr) {
+                        return end;
+                    }
+                    p = close;
+                    afterEquals = false;
+                } else if (c == '=') {
+                    afterEquals = true;
+                } else if (static_cast<unsigned char>(c) > ' ') {
+                    afterEquals = false;
+                }
+            }
+            return end;
+        }
+
+        static const char* SkipTag(const char* p, const char* end, std::string& out)
+        {
+            if (StartsWithNoCase(p, end, "<!--")) {
+                const char* close = Find(p + 4, end, "-->");
+                return close == end ? end : close + 3;
+            }
+
+            const char* gt = FindTagEnd(p, end);
+            const char* next = gt == end ? end : gt + 1;
+
+            if (StartsWithNoCase(p, end, "<script")) {
+                AppendSpace(out);
+                return SkipRawText(next, end, "</script");
+            }
+            if (StartsWithNoCase(p, end, "<style")) {
+                AppendSpace(out);
+                return SkipRawText(next, end, "</style");
+            }
+
+            // Tags separate words unless they are inline formatting
+            const char* name = p + 1;
+            if (name < end && *name == '/') {
+                name++;
+            }
+            if (not IsInline(name, end)) {
+                AppendSpace(out);
+            }
+
+            return next;
+        }
+
+        static bool IsInline(const char* name, const char* end)
+        {
+            char tag[8] = {};
+            std::size_t length = 0;
+            while (name + length < end && length < sizeof(tag)) {
+                char c = name[length];
+                if (c == '>' || c == '/' || static_cast<unsigned char>(c) <= ' ') {
+                    break;
+                }
+                tag[length++] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+            }
+
+            static const char* const inlineTags[] = {
+                "a", "abbr", "b", "bdi", "bdo", "cite", "code", "em", "i", "kbd", "mark",
+                "q", "s", "samp", "small", "span", "strong", "sub", "sup", "u", "var"
+            };
+
+            for (const char* candidate : inlineTags) {
+                if (candidate[0] == tag[0] && std::strlen(candidate) == length
+                        && std::memcmp(candidate, tag, length) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static const char* DecodeReference(const char* p, const char* end, std::string& out)
+        {
+            const std::size_t maxLength = 10;
+            const char* limit = (static_cast<std::size_t>(end - p) > maxLength) ? p + maxLength : end;
+            const char* semicolon = static_cast<const char*>(std::memchr(p, ';', limit - p));
+            if (semicolon == nullptr) {
+                out += '&';
+                return p + 1;
+            }
+
+            std::string name(p + 1, semicolon);
+            if (name.size() > 1 && name[0] == '#') {
+                bool hex = name[1] == 'x' || name[1] == 'X';
+                const char* digits = name.c_str() + (hex ? 2 : 1);
+                char* parsed = nullptr;
+                unsigned long cp = std::strtoul(digits, &parsed, hex ? 16 : 10);
+                if (parsed == digits || *parsed != '\0' || not std::isxdigit(static_cast<unsigned char>(*digits))) {
+                    // Not a number: keep the text as written
+                    out.append(p, semicolon + 1);
+                } else if (cp == 0 || (cp >= 0xD800 && cp <= 0xDFFF)) {
+                    AppendUTF8(out, 0xFFFD);
+                } else {
+                    AppendCharacter(out, cp);
+                }
+            } else if (unsigned long cp = NamedReference(name)) {
+                AppendCharacter(out, cp);
+            } else {
+                out.append(p, semicolon + 1);
+            }
+
+            return semicolon + 1;
+        }
+
+        /**
+         * Return the code point of a named character reference, or 0 for
+         * a name outside the table.
+         */
+        static unsigned long NamedReference(const std::string& name)
+        {
+            struct Reference {
+                const char*   Name;
+                unsigned long CodePoint;
+            };
+
+            // Sorted by name, byte by byte
+            static const Reference references[] = {
+                {"AElig", 0xC6}, {"Aacute", 0xC1}, {"Acirc", 0xC2}, {"Agrave", 0xC0},
+                {"Aring", 0xC5}, {"Atilde", 0xC3}, {"Auml", 0xC4}, {"Ccedil", 0xC7},
+                {"Dagger", 0x2021}, {"ETH", 0xD0}, {"Eacute", 0xC9}, {"Ecirc", 0xCA},
+                {"Egrave", 0xC8}, {"Euml", 0xCB}, {"Iacute", 0xCD}, {"Icirc", 0xCE},
+                {"Igrave", 0xCC}, {"Iuml", 0xCF}, {"Ntilde", 0xD1}, {"OElig", 0x152},
+                {"Oacute", 0xD3}, {"Ocirc", 0xD4}, {"Ograve", 0xD2}, {"Oslash", 0xD8},
+                {"Otilde", 0xD5}, {"Ouml", 0xD6}, {"Prime", 0x2033}, {"Scaron", 0x160},
+                {"THORN", 0xDE}, {"Uacute", 0xDA}, {"Ucirc", 0xDB}, {"Ugrave", 0xD9},
+                {"Uuml", 0xDC}, {"Yacute", 0xDD}, {"Yuml", 0x178}, {"aacute", 0xE1},
+                {"acirc", 0xE2}, {"acute", 0xB4}, {"aelig", 0xE6}, {"agrave", 0xE0}, {"amp", 0x26},
+                {"apos", 0x27}, {"aring", 0xE5}, {"atilde", 0xE3}, {"auml", 0xE4},
+                {"bdquo", 0x201E}, {"brvbar", 0xA6}, {"bull", 0x2022}, {"ccedil", 0xE7},
+                {"cedil", 0xB8}, {"cent", 0xA2}, {"circ", 0x2C6}, {"copy", 0xA9}, {"curren", 0xA4},
+                {"dagger", 0x2020}, {"deg", 0xB0}, {"divide", 0xF7}, {"eacute", 0xE9},
+                {"ecirc", 0xEA}, {"egrave", 0xE8}, {"emsp", 0x2003}, {"ensp", 0x2002},
+                {"eth", 0xF0}, {"euml", 0xEB}, {"euro", 0x20AC}, {"fnof", 0x192}, {"frac12", 0xBD},
+                {"frac14", 0xBC}, {"frac34", 0xBE}, {"frasl", 0x2044}, {"gt", 0x3E},
+                {"hellip", 0x2026}, {"iacute", 0xED}, {"icirc", 0xEE}, {"iexcl", 0xA1},
+                {"igrave", 0xEC}, {"iquest", 0xBF}, {"iuml", 0xEF}, {"laquo", 0xAB},
+                {"ldquo", 0x201C}, {"lrm", 0x200E}, {"lsaquo", 0x2039}, {"lsquo", 0x2018},
+                {"lt", 0x3C}, {"macr", 0xAF}, {"mdash", 0x2014}, {"micro", 0xB5}, {"middot", 0xB7},
+                {"nbsp", 0xA0}, {"ndash", 0x2013}, {"not", 0xAC}, {"ntilde", 0xF1},
+                {"oacute", 0xF3}, {"ocirc", 0xF4}, {"oelig", 0x153}, {"ograve", 0xF2},
+                {"oline", 0x203E}, {"ordf", 0xAA}, {"ordm", 0xBA}, {"oslash", 0xF8},
+                {"otilde", 0xF5}, {"ouml", 0xF6}, {"para", 0xB6}, {"permil", 0x2030},
+                {"plusmn", 0xB1}, {"pound", 0xA3}, {"prime", 0x2032}, {"quot", 0x22},
+                {"raquo", 0xBB}, {"rdquo", 0x201D}, {"reg", 0xAE}, {"rlm", 0x200F},
+                {"rsaquo", 0x203A}, {"rsquo", 0x2019}, {"sbquo", 0x201A}, {"scaron", 0x161},
+                {"sect", 0xA7}, {"shy", 0xAD}, {"sup1", 0xB9}, {"sup2", 0xB2}, {"sup3", 0xB3},
+                {"szlig", 0xDF}, {"thinsp", 0x2009}, {"thorn", 0xFE}, {"tilde", 0x2DC},
+                {"times", 0xD7}, {"trade", 0x2122}, {"uacute", 0xFA}, {"ucirc", 0xFB},
+                {"ugrave", 0xF9}, {"uml", 0xA8}, {"uuml", 0xFC}, {"yacute", 0xFD}, {"yen", 0xA5},
+                {"yuml", 0xFF}, {"zwj", 0x200D}, {"zwnj", 0x200C}
+            };
+
+            auto found = std::lower_bound(std::begin(references), std::end(references), name,
+                    [] (const Reference& reference, const std::string& key) {
+                        return std::strcmp(reference.Name, key.c_str()) < 0;
+                    });
+            if (found == std::end(references) || name != found->Name) {
+                return 0;
+            }
+            return found->CodePoint;
+        }
+
+        /**
+         * Append a decoded character, spaces of any width as a single one.
+         */
+        static void AppendCharacter(std::string& out, unsigned long cp)
+        {
+            if (cp <= ' ' || cp == 0xA0 || (cp >= 0x2000 && cp <= 0x200A)) {
+                AppendSpace(out);
+            } else {
+                AppendUTF8(out, cp);
+            }
+        }
+
+        static void AppendUTF8(std::string& out, unsigned long cp)
+        {
+            if (cp > 0x10FFFF) {
+                cp = 0xFFFD;
+            }
+
+            if (cp < 0x80) {
+                out += static_cast<char>(cp);
+            } else if (cp < 0x800) {
+                out += static_cast<char>(0xC0 | (cp >> 6));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            } else if (cp < 0x10000) {
+                out += static_cast<char>(0xE0 | (cp >> 12));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            } else {
+                out += static_cast<char>(0xF0 | (cp >> 18));
+                out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+        }
+};
+
+#endif /* ifndef FDLY_HTML_HEADER_SRC_H */
@@ -0,0 +1,390 @@
+/**
+ * @file
+ * Contains the FdlyLoop class which performs many HTTP requests concurrently
+ * from a single I/O thread.
+ */
+#ifndef FDLY_LOOP_HEADER_SRC_H
+#define FDLY_LOOP_HEADER_SRC_H
+
+#include <curl/curl.h>
+#include <cpr/cpr.h>
+
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @class Non-blocking request loop
+ *
+ * Requests are handed to a libcurl multi handle driven by a dedicated I/O
+ * thread, so any number of them can be in flight at once. Completion
+ * callbacks run on a small pool of worker threads and never on the I/O
+ * thread, which keeps parsing from stalling the transfers.
+ *
+ * An exception thrown by a callback or task does not escape its worker; it
+ * is stored in the future returned when the work was submitted.
+ */
+class FdlyLoop {
+    public:
+        using Callback = std::function<void(cpr::Response)>;
+
+        /**
+         * Query parameters of a request, in the order they are sent.
+         */
+        using Query = std::vector<std::pair<std::string, std::string>>;
+
+        /**
+         * Start the I/O thread and the callback workers.
+         *
+         * Requests to the same host are multiplexed as HTTP/2 streams over
+         * shared connections whenever the server supports it.
+         *
+         * @param workers         number of threads running completion callbacks
+         * @param maxConnections  most connections opened to a single host, 0
+         *                        for no limit
+         */
+        FdlyLoop(unsigned int workers = 2, long maxConnections = 0) :
+            m_multi(curl_multi_init()),
+            m_stopping(false),
+            m_active(0)
+        {
+            if (m_multi == nullptr) {
+                throw std::runtime_error("Could not initialize curl multi handle");
+            }
+
+            curl_multi_setopt(m_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+            if (maxConnections > 0) {
+                curl_multi_setopt(m_multi, CURLMOPT_MAX_HOST_CONNECTIONS, maxConnections);
+            }
+
+            if (workers == 0) {
+                workers = 1;
+            }
+
+            for (unsigned int i = 0; i < workers; i++) {
+                m_workers.emplace_back(&FdlyLoop::Work, this);
+            }
+
+            m_ioThread = std::thread(&FdlyLoop::Run, this);
+        }
+
+        FdlyLoop(const FdlyLoop&) = delete;
+        FdlyLoop& operator=(const FdlyLoop&) = delete;
+
+        /**
+         * Wait for the requests in flight to complete and stop all threads.
+         */
+        ~FdlyLoop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            curl_multi_wakeup(m_multi);
+            m_ioThread.join();
+
+            {
+                std::lock_guard<std::mutex> lock(m_tasksMutex);
+                m_tasksDone = true;
+            }
+            m_tasksChanged.notify_all();
+            for (auto& worker : m_workers) {
+                worker.join();
+            }
+
+            curl_multi_cleanup(m_multi);
+        }
+
+        /**
+         * Start a GET request.
+         *
+         * @param url       the request URL, including its query string
+         * @param header    the request headers
+         * @param callback  called with the response once it has completed
+         *
+         * @return ready once the callback has returned, holding what it threw
+         */
+        std::future<void> Get(const std::string& url, const cpr::Header& header, Callback callback)
+        {
+            return Submit(url, header, nullptr, std::move(callback));
+        }
+
+        /**
+         * Start a POST request.
+         *
+         * @param url       the request URL
+         * @param header    the request headers
+         * @param body      the request body
+         * @param callback  called with the response once it has completed
+         *
+         * @return ready once the callback has returned, holding what it threw
+         */
+        std::future<void> Post(const std::string& url, const cpr::Header& header, const std::string& body, Callback callback)
+        {
+            return Submit(url, header, &body, std::move(callback));
+        }
+
+        /**
+         * Run a task on the callback workers.
+         *
+         * @return ready once the task has returned, holding what it threw
+         */
+        std::future<void> Dispatch(std::function<void()> task)
+        {
+            auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+            auto future = packaged->get_future();
+            {
+                std::lock_guard<std::mutex> lock(m_tasksMutex);
+                m_tasks.push_back([packaged] () {
+                    (*packaged)();
+                });
+            }
+            m_tasksChanged.notify_one();
+            return future;
+        }
+
+        /**
+         * Append URL encoded query parameters to a URL.
+         */
+        static std::string BuildUrl(const std::string& url, const Query& query)
+        {
+            std::string out = url;
+            char separator = '?';
+            for (const auto& param : query) {
+                out += separator;
+                AppendEscaped(out, param.first);
+                out += '=';
+                AppendEscaped(out, param.second);
+                separator = '&';
+            }
+            return out;
+        }
+
+    private:
+        struct Transfer {
+            CURL*              Easy;
+            curl_slist*        Headers;
+            std::string        Body;
+            cpr::Response      Response;
+            Callback           OnDone;
+            std::promise<void> Done;
+
+            ~Transfer()
+            {
+                curl_slist_free_all(Headers);
+                curl_easy_cleanup(Easy);
+            }
+        };
+
+        static void AppendEscaped(std::string& out, const std::string& value)
+        {
+            static const char hex[] = "0123456789ABCDEF";
+            for (char c : value) {
+                unsigned char u = static_cast<unsigned char>(c);
+                if (std::isalnum(u) || c == '-' || c == '_' || c == '.' || c == '~') {
+                    out += c;
+                } else {
+                    out += '%';
+                    out += hex[u >> 4];
+                    out += hex[u & 0x0F];
+                }
+            }
+        }
+
+        static size_t WriteBody(char* data, size_t size, size_t count, void* userdata)
+        {
+            auto* transfer = static_cast<Transfer*>(userdata);
+            transfer->Response.text.append(data, size * count);
+            return size * count;
+        }
+
+        static size_t WriteHeader(char* data, size_t size, size_t count, void* userdata)
+        {
+            auto* transfer = static_cast<Transfer*>(userdata);
+            std::string line(data, size * count);
+
+            if (line.compare(0, 5, "HTTP/") == 0) {
+                // A new status line starts the headers of a redirect or of
+                // the final response
+                transfer->Response.header.clear();
+            } else {
+                auto colon = line.find(':');
+                if (colon != std::string::npos) {
+                    auto begin = line.find_first_not_of(" \t", colon + 1);
+                    auto end = line.find_last_not_of(" \t\r\n");
+                    std::string value;
+                    if (begin != std::string::npos && end != std::string::npos && end >= begin) {
+                        value = line.substr(begin, end - begin + 1);
+                    }
+                    transfer->Response.header[line.substr(0, colon)] = value;
+                }
+            }
+
+            return size * count;
+        }
+
+        std::future<void> Submit(const std::string& url, const cpr::Header& header, const std::string* body, Callback callback)
+        {
+            std::unique_ptr<Transfer> transfer(new Transfer {curl_easy_init(), nullptr, "", cpr::Response {}, std::move(callback), {}});
+            if (transfer->Easy == nullptr) {
+                throw std::runtime_error("Could not initialize curl handle");
+            }
+
+            for (const auto& item : header) {
+                std::string line = item.first + ": " + item.second;
+                transfer->Headers = curl_slist_append(transfer->Headers, line.c_str());
+            }
+
+            CURL* easy = transfer->Easy;
+            curl_easy_setopt(easy, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->Headers);
+            curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+            curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+            curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+            // Wait for a connection that can multiplex rather than opening
+            // a new one for every request started at the same time
+            curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+            curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &FdlyLoop::WriteBody);
+            curl_easy_setopt(easy, CURLOPT_WRITEDATA, transfer.get());
+            curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, &FdlyLoop::WriteHeader);
+            curl_easy_setopt(easy, CURLOPT_HEADERDATA, transfer.get());
+            curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer.get());
+
+            if (body != nullptr) {
+                transfer->Body = *body;
+                curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, static_cast<long>(transfer->Body.size()));
+                curl_easy_setopt(easy, CURLOPT_POSTFIELDS, transfer->Body.c_str());
+            }
+
+            auto done = transfer->Done.get_future();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_stopping) {
+                    throw std::runtime_error("Request submitted to a stopping loop");
+                }
+                m_submitted.push_back(std::move(transfer));
+            }
+            curl_multi_wakeup(m_multi);
+            return done;
+        }
+
+        void Run()
+        {
+            while (true) {
+                std::vector<std::unique_ptr<Transfer>> submitted;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_stopping && m_submitted.empty() && m_active == 0) {
+                        break;
+                    }
+                    submitted.swap(m_submitted);
+                }
+
+                for (auto& transfer : submitted) {
+                    curl_multi_add_handle(m_multi, transfer->Easy);
+                    transfer.release();
+                    m_active++;
+                }
+
+                int running = 0;
+                curl_multi_perform(m_multi, &running);
+
+                CURLMsg* msg;
+                int pending = 0;
+                while ((msg = curl_multi_info_read(m_multi, &pending)) != nullptr) {
+                    if (msg->msg != CURLMSG_DONE) {
+                        continue;
+                    }
+
+                    Transfer* raw = nullptr;
+                    curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &raw);
+                    curl_multi_remove_handle(m_multi, msg->easy_handle);
+                    m_active--;
+
+                    Complete(std::unique_ptr<Transfer>(raw), msg->data.result);
+                }
+
+                curl_multi_poll(m_multi, nullptr, 0, 1000, nullptr);
+            }
+        }
+
+        void Complete(std::unique_ptr<Transfer> transfer, CURLcode result)
+        {
+            cpr::Response& response = transfer->Response;
+
+            long status = 0;
+            curl_easy_getinfo(transfer->Easy, CURLINFO_RESPONSE_CODE, &status);
+            response.status_code = status;
+
+            double elapsed = 0;
+            curl_easy_getinfo(transfer->Easy, CURLINFO_TOTAL_TIME, &elapsed);
+            response.elapsed = elapsed;
+
+            char* effectiveUrl = nullptr;
+            curl_easy_getinfo(transfer->Easy, CURLINFO_EFFECTIVE_URL, &effectiveUrl);
+            if (effectiveUrl != nullptr) {
+                response.url = effectiveUrl;
+            }
+
+            if (result != CURLE_OK) {
+                response.error = cpr::Error(result, std::string(curl_easy_strerror(result)));
+            }
+
+            std::shared_ptr<Transfer> done(std::move(transfer));
+            {
+                std::lock_guard<std::mutex> lock(m_tasksMutex);
+                m_tasks.push_back([done] () {
+                    try {
+                        done->OnDone(std::move(done->Response));
+                        done->Done.set_value();
+                    } catch (...) {
+                        done->Done.set_exception(std::current_exception());
+                    }
+                });
+            }
+            m_tasksChanged.notify_one();
+        }
+
+        void Work()
+        {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(m_tasksMutex);
+                    m_tasksChanged.wait(lock, [this] { return m_tasksDone || not m_tasks.empty(); });
+                    if (m_tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop_front();
+                }
+                // Queued tasks store whatever they throw in their future
+                task();
+            }
+        }
+
+        CURLM* m_multi;
+
+        std::mutex m_mutex;
+        bool m_stopping;
+        std::vector<std::unique_ptr<Transfer>> m_submitted;
+        std::size_t m_active;
+        std::thread m_ioThread;
+
+        std::mutex m_tasksMutex;
+        std::condition_variable m_tasksChanged;
+        std::deque<std::function<void()>> m_tasks;
+        bool m_tasksDone = false;
+        std::vector<std::thread> m_workers;
+};
+
+#endif /* ifndef FDLY_LOOP_HEADER_SRC_H */
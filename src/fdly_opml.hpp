@@ -0,0 +1,586 @@
+/**
+ * @file
+ * Contains the OPML class which imports and exports Feedly subscriptions as
+ * OPML documents.
+ */
+#ifndef FDLY_OPML_HEADER_SRC_H
+#define FDLY_OPML_HEADER_SRC_H
+
+#include "fdly.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * @class Import and export subscriptions as OPML
+ */
+class OPML {
+    public:
+        /**
+         * A feed outline read from an OPML document.
+         */
+        struct Outline {
+            std::string Title;
+            std::string XmlUrl;
+            std::string HtmlUrl;
+            std::vector<std::string> CategoryLabels;
+        };
+
+        /**
+         * Outcome of subscribing to a single imported feed.
+         */
+        struct ImportResult {
+            Fdly::Feed  Feed;
+            bool        Succeeded;
+            std::string Error;
+        };
+
+        /**
+         * Streaming reader returning feed outlines one at a time.
+         *
+         * Outlines without an xmlUrl are treated as categories and their label
+         * is applied to every feed nested inside them. The labels of a feed
+         * outline's own category attribute, a comma separated list of
+         * "/label" paths, are added to them.
+         */
+        class Reader {
+            public:
+                Reader(std::istream& in) :
+                    m_in(in)
+                {
+                }
+
+                /**
+                 * Read the next feed outline.
+                 *
+                 * @param outline  filled with the next feed outline
+                 *
+                 * @return false once the end of the document has been reached
+                 */
+                bool Next(Outline& outline)
+                {
+                    char c;
+                    while (m_in.get(c)) {
+                        if (c != '<') {
+                            continue;
+                        }
+
+                        if (not m_in.get(c)) {
+                            break;
+                        }
+
+                        if (c == '!') {
+                            SkipDeclaration();
+                        } else if (c == '?') {
+                            SkipUntil("?>");
+                        } else if (c == '/') {
+                            std::string name = ReadName();
+                            SkipUntil(">");
+                            if (name == "outline" && not m_labels.empty()) {
+                                m_labels.pop_back();
+                            }
+                        } else {
+                            m_in.putback(c);
+                            std::string name = ReadName();
+                            std::map<std::string, std::string> attributes;
+                            bool selfClosing = ReadAttributes(attributes);
+
+                            if (name != "outline") {
+                                continue;
+                            }
+
+                            auto xmlUrl = attributes.find("xmlUrl");
+                            if (xmlUrl == attributes.end()) {
+                                if (not selfClosing) {
+                                    m_labels.push_back(Attribute(attributes, "title", "text"));
+                                }
+                                continue;
+                            }
+
+                            outline.Title = Attribute(attributes, "title", "text");
+                            outline.XmlUrl = xmlUrl->second;
+                            outline.HtmlUrl = Attribute(attributes, "htmlUrl", "htmlUrl");
+                            outline.CategoryLabels.clear();
+                            for (const auto& label : m_labels) {
+                                AddLabel(outline, label);
+                            }
+                            std::string categories = Attribute(attributes, "category", "category");
+                            std::size_t begin = 0;
+                            while (begin <= categories.size()) {
+                                std::size_t end = std::min(categories.find(',', begin), categories.size());
+                                std::size_t first = categories.find_first_not_of(" /", begin);
+                                std::size_t last = categories.find_last_not_of(' ', end == 0 ? 0 : end - 1);
+                                if (first < end && last != std::string::npos && last >= first) {
+                                    AddLabel(outline, categories.substr(first, last - first + 1));
+                                }
+                                begin = end + 1;
+                            }
+
+                            if (not selfClosing) {
+                                // Keep the stack balanced for the closing tag
+                                m_labels.push_back("");
+                            }
+
+                            return true;
+                        }
+                    }
+
+                    return false;
+                }
+
+            private:
+                static void AddLabel(Outline& outline, const std::string& label)
+                {
+                    auto& labels = outline.CategoryLabels;
+                    if (not label.empty() && std::find(labels.begin(), labels.end(), label) == labels.end()) {
+                        labels.push_back(label);
+                    }
+                }
+
+                static std::string Attribute(
+                        const std::map<std::string, std::string>& attributes,
+                        const std::string& name,
+                        const std::string& fallback)
+                {
+                    auto it = attributes.find(name);
+                    if (it == attributes.end() || it->second.empty()) {
+                        it = attributes.find(fallback);
+                    }
+                    return it == attributes.end() ? "" : it->second;
+                }
+
+                void SkipUntil(const std::string& terminator)
+                {
+                    std::size_t matched = 0;
+                    char c;
+                    while (matched < terminator.size() && m_in.get(c)) {
+                        if (c == terminator[matched]) {
+                            matched++;
+                        } else {
+                            matched = (c == terminator[0]) ? 1 : 0;
+                        }
+                    }
+                }
+
+                void SkipDeclaration()
+                {
+                    if (m_in.peek() == '-') {
+                        SkipUntil("-->");
+                    } else if (m_in.peek() == '[') {
+                        SkipUntil("]]>");
+                    } else {
+                        SkipUntil(">");
+                    }
+                }
+
+                std::string ReadName()
+                {
+                    std::string name;
+                    char c;
+                    while (m_in.get(c)) {
+                        if (std::isspace(static_cast<unsigned char>(c)) || c == '>' || c == '/' || c == '=') {
+                            m_in.putback(c);
+                            break;
+                        }
+                        name += c;
+                    }
+                    return name;
+                }
+
+                /**
+                 * Read attributes up to the end of a start tag.
+                 *
+                 * @return true if the tag was self-closing
+                 */
+                bool ReadAttributes(std::map<std::string, std::string>& attributes)
+                {
+                    char c;
+                    bool selfClosing = false;
+                    while (m_in.get(c)) {
+                        if (c == '>') {
+                            return selfClosing;
+                        }
+
+                        if (c == '/') {
+                            selfClosing = true;
+                            continue;
+                        }
+
+                        selfClosing = false;
+                        if (std::isspace(static_cast<unsigned char>(c))) {
+                            continue;
+                        }
+
+                        m_in.putback(c);
+                        std::string name = ReadName();
+                        std::string value;
+
+                        while (m_in.get(c) && std::isspace(static_cast<unsigned char>(c))) {
+                        }
+
+                        if (c != '=') {
+                            m_in.putback(c);
+                            attributes[name] = value;
+                            continue;
+                        }
+
+                        while (m_in.get(c) && std::isspace(static_cast<unsigned char>(c))) {
+                        }
+
+                        if (c == '"' || c == '\'') {
+                            char quote = c;
+                            while (m_in.get(c) && c != quote) {
+                                value += c;
+                            }
+                        } else if (c == '>') {
+                            m_in.putback(c);
+                        } else if (m_in) {
+                            // Unquoted value, as lenient parsers accept
+                            value += c;
+                            while (m_in.get(c)) {
+                                if (std::isspace(static_cast<unsigned char>(c)) || c == '>') {
+                                    m_in.putback(c);
+                                    break;
+                                }
+                                value += c;
+                            }
+                        }
+
+                        attributes[name] = DecodeEntities(value);
+                    }
+
+                    return selfClosing;
+                }
+
+                static std::string DecodeEntities(const std::string& value)
+                {
+                    std::string out;
+                    out.reserve(value.size());
+
+                    std::size_t i = 0;
+                    while (i < value.size()) {
+                        std::size_t end;
+                        if (value[i] != '&' || (end = value.find(';', i)) == std::string::npos) {
+                            out += value[i++];
+                            continue;
+                        }
+
+                        std::string entity = value.substr(i + 1, end - i - 1);
+                        if (entity == "amp") {
+                            out += '&';
+                        } else if (entity == "lt") {
+                            out += '<';
+                        } else if (entity == "gt") {
+                            out += '>';
+                        } else if (entity == "quot") {
+                            out += '"';
+                        } else if (entity == "apos") {
+                            out += '\'';
+                        } else if (entity.size() > 1 && entity[0] == '#') {
+                            unsigned long cp = (entity[1] == 'x' || entity[1] == 'X')
+                                ? std::strtoul(entity.c_str() + 2, nullptr, 16)
+                                : std::strtoul(entity.c_str() + 1, nullptr, 10);
+                            AppendUTF8(out, cp);
+                        } else {
+                            out += value.substr(i, end - i + 1);
+                        }
+
+                        i = end + 1;
+                    }
+
+                    return out;
+                }
+
+                static void AppendUTF8(std::string& out, unsigned long cp)
+                {
+                    if (cp == 0 || (cp >= 0xD800 && cp < 0xE000) || cp > 0x10FFFF) {
+                        // Not a character, use the replacement character
+                        cp = 0xFFFD;
+                    }
+
+                    if (cp < 0x80) {
+                        out += static_cast<char>(cp);
+                    } else if (cp < 0x800) {
+                        out += static_cast<char>(0xC0 | (cp >> 6));
+                        out += static_cast<char>(0x80 | (cp & 0x3F));
+                    } else if (cp < 0x10000) {
+                        out += static_cast<char>(0xE0 | (cp >> 12));
+                        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                        out += static_cast<char>(0x80 | (cp & 0x3F));
+                    } else {
+                        out += static_cast<char>(0xF0 | (cp >> 18));
+                        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                        out += static_cast<char>(0x80 | (cp & 0x3F));
+                    }
+                }
+
+                std::istream& m_in;
+                std::vector<std::string> m_labels;
+        };
+
+        /**
+         * Subscribe to every feed of an OPML document.
+         *
+         * The document is read incrementally while at most maxInFlight
+         * subscriptions are being created concurrently. A failing feed does
+         * not stop the import; its error is reported in the result instead.
+         *
+         * Outlines sharing an xmlUrl are one feed in every category they
+         * appear in. Since each subscription request replaces the categories
+         * of the feed, a feed found again after its request was sent is sent
+         * once more with all of them, after the first request completed.
+         *
+         * @param fdly         the connection to subscribe with
+         * @param in           the OPML document
+         * @param maxInFlight  maximum number of concurrent requests
+         *
+         * @return one result per feed, in the order of their first outline
+         */
+        static std::vector<ImportResult> Import(Fdly& fdly, std::istream& in, unsigned int maxInFlight = 8)
+        {
+            if (maxInFlight == 0) {
+                throw std::runtime_error("maxInFlight must be greater than zero");
+            }
+
+            std::vector<ImportResult> results;
+            std::vector<Progress> progress;
+            std::unordered_map<std::string, std::size_t> byUrl;
+            std::deque<std::size_t> pending;
+            std::mutex mutex;
+            std::condition_variable queueChanged;
+            bool done = false;
+
+            auto worker = [&] () {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (true) {
+                    queueChanged.wait(lock, [&] { return done || not pending.empty(); });
+                    if (pending.empty()) {
+                        return;
+                    }
+
+                    std::size_t index = pending.front();
+                    pending.pop_front();
+                    progress[index].Queued = false;
+                    progress[index].Sending = true;
+                    Fdly::Feed feed = results[index].Feed;
+                    queueChanged.notify_all();
+                    lock.unlock();
+
+                    bool succeeded = true;
+                    std::string error;
+                    try {
+                        fdly.AddSubscription(feed);
+                    } catch (const std::exception& e) {
+                        succeeded = false;
+                        error = e.what();
+                    }
+
+                    lock.lock();
+                    results[index].Succeeded = succeeded;
+                    results[index].Error = error;
+                    progress[index].Sending = false;
+                    if (progress[index].Resend) {
+                        progress[index].Resend = false;
+                        Queue(index, progress, pending);
+                        queueChanged.notify_all();
+                    }
+                }
+            };
+
+            // Let the workers drain the queue and join them however the
+            // parsing ends, so that no joinable thread is left behind
+            auto finish = [&] (std::vector<std::thread>& workers) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done = true;
+                }
+                queueChanged.notify_all();
+
+                for (auto& t : workers) {
+                    t.join();
+                }
+            };
+
+            std::vector<std::thread> workers;
+            try {
+                for (unsigned int i = 0; i < maxInFlight; i++) {
+                    workers.emplace_back(worker);
+                }
+
+                Reader reader(in);
+                Outline outline;
+                while (reader.Next(outline)) {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    queueChanged.wait(lock, [&] { return pending.size() < maxInFlight; });
+
+                    auto known = byUrl.find(outline.XmlUrl);
+                    if (known != byUrl.end()) {
+                        std::size_t index = known->second;
+                        bool added = false;
+                        for (const auto& label : outline.CategoryLabels) {
+                            added |= results[index].Feed.Categories.append(Fdly::Category {label, fdly.CategoryID(label)});
+                        }
+                        if (not added || progress[index].Queued) {
+                            continue;
+                        }
+                        if (progress[index].Sending) {
+                            progress[index].Resend = true;
+                        } else {
+                            Queue(index, progress, pending);
+                        }
+                        queueChanged.notify_all();
+                        continue;
+                    }
+
+                    Fdly::Feed feed {};
+                    feed.Title = outline.Title;
+                    feed.Url = outline.XmlUrl;
+                    for (const auto& label : outline.CategoryLabels) {
+                        feed.Categories.append(Fdly::Category {label, fdly.CategoryID(label)});
+                    }
+
+                    byUrl.emplace(outline.XmlUrl, results.size());
+                    results.push_back(ImportResult {feed, false, ""});
+                    progress.push_back(Progress {});
+                    Queue(results.size() - 1, progress, pending);
+                    queueChanged.notify_all();
+                }
+            } catch (...) {
+                finish(workers);
+                throw;
+            }
+
+            finish(workers);
+
+            return results;
+        }
+
+        /**
+         * Write the user's subscriptions as an OPML document.
+         *
+         * @param fdly  the connection to read subscriptions from
+         * @param out   the stream to write the document to
+         */
+        static void Export(Fdly& fdly, std::ostream& out)
+        {
+            Export(fdly.GetSubscriptions(), out);
+        }
+
+        /**
+         * Write feeds as an OPML document, grouped by category.
+         *
+         * A feed is written once, inside the outline of its first category,
+         * with all of its categories in its category attribute so that
+         * importing the document subscribes to it once.
+         *
+         * @param feeds  the feeds to export
+         * @param out    the stream to write the document to
+         */
+        static void Export(const Fdly::Feeds& feeds, std::ostream& out)
+        {
+            std::map<std::string, std::vector<const Fdly::Feed*>> byCategory;
+            std::vector<const Fdly::Feed*> uncategorized;
+            for (const auto& feed : feeds) {
+                if (feed.Categories.empty()) {
+                    uncategorized.push_back(&feed);
+                } else {
+                    byCategory[(*feed.Categories.begin()).Label.str()].push_back(&feed);
+                }
+            }
+
+            out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                << "<opml version=\"1.0\">\n"
+                << "  <head>\n"
+                << "    <title>Feedly subscriptions</title>\n"
+                << "  </head>\n"
+                << "  <body>\n";
+
+            for (const auto& category : byCategory) {
+                out << "    <outline text=\"";
+                WriteEscaped(out, category.first);
+                out << "\" title=\"";
+                WriteEscaped(out, category.first);
+                out << "\">\n";
+                for (const auto* feed : category.second) {
+                    WriteFeed(out, *feed, "      ");
+                }
+                out << "    </outline>\n";
+            }
+
+            for (const auto* feed : uncategorized) {
+                WriteFeed(out, *feed, "    ");
+            }
+
+            out << "  </body>\n"
+                << "</opml>\n";
+        }
+
+    private:
+        /**
+         * Where a feed being imported stands.
+         */
+        struct Progress {
+            bool Queued = false;
+            bool Sending = false;
+            bool Resend = false;
+        };
+
+        static void Queue(std::size_t index, std::vector<Progress>& progress, std::deque<std::size_t>& pending)
+        {
+            progress[index].Queued = true;
+            pending.push_back(index);
+        }
+
+        static void WriteFeed(std::ostream& out, const Fdly::Feed& feed, const char* indent)
+        {
+            std::string xmlUrl = feed.ID;
+            if (xmlUrl.compare(0, 5, "feed/") == 0) {
+                xmlUrl.erase(0, 5);
+            }
+
+            out << indent << "<outline type=\"rss\" text=\"";
+            WriteEscaped(out, feed.Title);
+            out << "\" title=\"";
+            WriteEscaped(out, feed.Title);
+            out << "\" xmlUrl=\"";
+            WriteEscaped(out, xmlUrl);
+            out << "\" htmlUrl=\"";
+            WriteEscaped(out, feed.Url);
+            if (not feed.Categories.empty()) {
+                out << "\" category=\"";
+                const char* separator = "";
+                for (const auto& ctg : feed.Categories) {
+                    out << separator << '/';
+                    WriteEscaped(out, ctg.Label.str());
+                    separator = ",";
+                }
+            }
+            out << "\"/>\n";
+        }
+
+        static void WriteEscaped(std::ostream& out, const std::string& value)
+        {
+            for (char c : value) {
+                switch (c) {
+                    case '&':  out << "&amp;";  break;
+                    case '<':  out << "&lt;";   break;
+                    case '>':  out << "&gt;";   break;
+                    case '"':  out << "&quot;"; break;
+                    case '\'': out << "&apos;"; break;
+                    default:   out << c;        break;
+                }
+            }
+        }
+};
+
+#endif /* ifndef FDLY_OPML_HEADER_SRC_H */
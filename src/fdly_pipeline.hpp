@@ -0,0 +1,415 @@
+/**
+ * @file
+ * Contains the EntriesPipeline class which overlaps fetching, decoding and
+ * processing of stream pages.
+ */
+#ifndef FDLY_PIPELINE_HEADER_SRC_H
+#define FDLY_PIPELINE_HEADER_SRC_H
+
+#include "fdly.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+ * @class Bounded single producer, single consumer lock-free queue
+ *
+ * TryPush and TryPop never block. Push and Pop spin briefly and then sleep
+ * on a condition variable, so a stage waiting on the network does not keep
+ * the others busy.
+ */
+template<class T>
+class SPSCQueue {
+    public:
+        /**
+         * @param capacity  maximum number of queued items, rounded up to a
+         *                  power of two
+         */
+        explicit SPSCQueue(std::size_t capacity) :
+            m_head(0),
+            m_tail(0),
+            m_closed(false),
+            m_sleepers(0)
+        {
+            std::size_t size = 1;
+            while (size < capacity) {
+                size <<= 1;
+            }
+            m_slots.resize(size);
+            m_mask = size - 1;
+        }
+
+        SPSCQueue(const SPSCQueue&) = delete;
+        SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+        /**
+         * Push an item if there is room for it. Producer only.
+         */
+        bool TryPush(T& item)
+        {
+            std::size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_head.load(std::memory_order_acquire) == m_slots.size()) {
+                return false;
+            }
+            m_slots[tail & m_mask] = std::move(item);
+            m_tail.store(tail + 1, std::memory_order_release);
+            Notify();
+            return true;
+        }
+
+        /**
+         * Pop an item if one is available. Consumer only.
+         */
+        bool TryPop(T& item)
+        {
+            std::size_t head = m_head.load(std::memory_order_relaxed);
+            if (head == m_tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = std::move(m_slots[head & m_mask]);
+            m_head.store(head + 1, std::memory_order_release);
+            Notify();
+            return true;
+        }
+
+        /**
+         * Push an item, waiting while the queue is full.
+         *
+         * @return false if the queue was closed while waiting
+         */
+        bool Push(T& item, const std::atomic<bool>& cancelled)
+        {
+            for (unsigned int spins = 0; not TryPush(item); spins++) {
+                if (cancelled) {
+                    return false;
+                }
+
+                if (spins < SpinLimit) {
+                    std::this_thread::yield();
+                } else {
+                    Wait([&] {
+                        return cancelled || m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_acquire) < m_slots.size();
+                    });
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Pop an item, waiting while the queue is empty.
+         *
+         * @return false once the queue is closed and drained, or if
+         *         cancelled while waiting
+         */
+        bool Pop(T& item, const std::atomic<bool>& cancelled)
+        {
+            for (unsigned int spins = 0; not TryPop(item); spins++) {
+                if (cancelled) {
+                    return false;
+                }
+                if (m_closed.load(std::memory_order_acquire)) {
+                    // Items pushed before closing are still delivered
+                    return TryPop(item);
+                }
+
+                if (spins < SpinLimit) {
+                    std::this_thread::yield();
+                } else {
+                    Wait([&] {
+                        return cancelled || m_closed.load(std::memory_order_acquire) ||
+                            m_head.load(std::memory_order_relaxed) != m_tail.load(std::memory_order_acquire);
+                    });
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Signal that no more items will be pushed. Producer only.
+         */
+        void Close()
+        {
+            m_closed.store(true, std::memory_order_release);
+            Notify();
+        }
+
+        /**
+         * Wake a side waiting in Push or Pop, so that it sees that the
+         * cancellation flag passed to it was set.
+         */
+        void Wake()
+        {
+            Notify();
+        }
+
+    private:
+        /** Times Push and Pop yield before they sleep */
+        static constexpr unsigned int SpinLimit = 64;
+
+        template<class Ready>
+        void Wait(Ready ready)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_sleepers.fetch_add(1);
+            // Pairs with the fence in Notify: either the waker sees the
+            // sleeper, or ready() sees what the waker changed
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            m_changed.wait(lock, ready);
+            m_sleepers.fetch_sub(1);
+        }
+
+        void Notify()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_sleepers.load(std::memory_order_relaxed) > 0) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_changed.notify_all();
+            }
+        }
+
+        std::vector<T> m_slots;
+        std::size_t m_mask;
+        std::atomic<std::size_t> m_head;
+        std::atomic<std::size_t> m_tail;
+        std::atomic<bool> m_closed;
+        std::atomic<int> m_sleepers;
+        std::mutex m_mutex;
+        std::condition_variable m_changed;
+};
+
+/**
+ * @class Pipelined ingestion of stream entries
+ *
+ * Pages are fetched, decoded and handed to the consumer on three separate
+ * threads connected by bounded queues. The fetch thread waits when the
+ * decoder falls behind and the decoder waits when the consumer does, so at
+ * most a fixed number of pages are ever buffered.
+ *
+ * Each stream is paged through with its continuation IDs. Since the next
+ * page of a stream can only be requested once the previous one has been
+ * decoded, the fetcher interleaves streams to keep the network busy. Fetching
+ * therefore only overlaps with decoding and processing across streams: the
+ * pages of a single stream are fetched and decoded one after the other, and
+ * only their processing overlaps with the next fetch.
+ */
+class EntriesPipeline {
+    public:
+        using Consumer = std::function<void(const std::string& streamId, Fdly::Entries& entries)>;
+
+        /**
+         * @param fdly      connection to fetch pages with
+         * @param capacity  number of pages buffered between each pair of stages
+         */
+        EntriesPipeline(const Fdly& fdly, std::size_t capacity = 4) :
+            m_fdly(fdly),
+            m_capacity(capacity == 0 ? 1 : capacity),
+            m_sortByOldest(false),
+            m_count(100),
+            m_unreadOnly(true),
+            m_maxPages(0)
+        {
+        }
+
+        /**
+         * Set the paging parameters used for every stream.
+         *
+         * @param sortByOldest  return the entries ordered by oldest
+         * @param count         number of entries per page
+         * @param unreadOnly    fetch only unread entries
+         * @param maxPages      maximum pages per stream, 0 for no limit
+         */
+        void SetPaging(bool sortByOldest, unsigned int count, bool unreadOnly, unsigned int maxPages = 0)
+        {
+            m_sortByOldest = sortByOldest;
+            m_count = count;
+            m_unreadOnly = unreadOnly;
+            m_maxPages = maxPages;
+        }
+
+        /**
+         * Fetch every page of the given streams and pass them to consumer.
+         *
+         * The consumer runs on its own thread, one page at a time. Pass
+         * several streams to overlap their fetches with decoding. If any
+         * stage throws, the pipeline is cancelled and the first exception is
+         * rethrown here once every stage has stopped.
+         *
+         * @param streamIds  category or stream IDs to fetch
+         * @param consumer   called for each decoded page
+         */
+        void Run(const std::vector<std::string>& streamIds, Consumer consumer)
+        {
+            SPSCQueue<RawPage> raw(m_capacity);
+            SPSCQueue<DecodedPage> decoded(m_capacity);
+            // The decoder answers every fetched page with one continuation
+            // and the fetcher drains them between fetches, so this can never
+            // fill up: at most the raw queue plus the page being pushed
+            SPSCQueue<Continuation> continuations(m_capacity + 2);
+
+            std::atomic<bool> cancelled(false);
+            std::exception_ptr error;
+            std::mutex errorMutex;
+
+            auto guard = [&] (std::function<void()> stage) {
+                return [&, stage] () {
+                    try {
+                        stage();
+                    } catch (...) {
+                        {
+                            std::lock_guard<std::mutex> lock(errorMutex);
+                            if (not error) {
+                                error = std::current_exception();
+                            }
+                        }
+                        cancelled = true;
+                        raw.Wake();
+                        decoded.Wake();
+                        continuations.Wake();
+                    }
+                };
+            };
+
+            std::thread fetcher(guard([&] { Fetch(streamIds, raw, continuations, cancelled); }));
+            std::thread decoder(guard([&] { Decode(raw, decoded, continuations, cancelled); }));
+            std::thread processor(guard([&] {
+                DecodedPage page;
+                while (decoded.Pop(page, cancelled)) {
+                    consumer(page.StreamID, page.Entries);
+                }
+            }));
+
+            fetcher.join();
+            decoder.join();
+            processor.join();
+
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+    private:
+        struct RawPage {
+            std::string StreamID;
+            cpr::Response Response;
+        };
+
+        struct DecodedPage {
+            std::string StreamID;
+            Fdly::Entries Entries;
+        };
+
+        struct Continuation {
+            std::string StreamID;
+            std::string ID;
+        };
+
+        struct Pending {
+            std::string StreamID;
+            std::string Continuation;
+            unsigned int Pages;
+        };
+
+        void Fetch(
+                const std::vector<std::string>& streamIds,
+                SPSCQueue<RawPage>& raw,
+                SPSCQueue<Continuation>& continuations,
+                const std::atomic<bool>& cancelled)
+        {
+            std::deque<Pending> ready;
+            std::vector<Pending> waiting;
+            for (const auto& id : streamIds) {
+                ready.push_back(Pending {id, "", 0});
+            }
+
+            while (not cancelled) {
+                Continuation next;
+                while (continuations.TryPop(next)) {
+                    Resume(next, ready, waiting);
+                }
+
+                if (ready.empty()) {
+                    if (waiting.empty()) {
+                        break;
+                    }
+
+                    if (not continuations.Pop(next, cancelled)) {
+                        break;
+                    }
+                    Resume(next, ready, waiting);
+                    continue;
+                }
+
+                Pending pending = std::move(ready.front());
+                ready.pop_front();
+
+                const auto& url = m_fdly.EntriesUrl(pending.StreamID, m_sortByOldest, m_count, m_unreadOnly, pending.Continuation);
+                RawPage page {pending.StreamID, m_fdly.SendGet(url)};
+
+                pending.Pages++;
+                waiting.push_back(std::move(pending));
+
+                if (not raw.Push(page, cancelled)) {
+                    break;
+                }
+            }
+
+            raw.Close();
+        }
+
+        void Resume(const Continuation& next, std::deque<Pending>& ready, std::vector<Pending>& waiting) const
+        {
+            for (auto it = waiting.begin(); it != waiting.end(); ++it) {
+                if (it->StreamID != next.StreamID) {
+                    continue;
+                }
+
+                Pending pending = std::move(*it);
+                waiting.erase(it);
+
+                bool more = not next.ID.empty() && (m_maxPages == 0 || pending.Pages < m_maxPages);
+                if (more) {
+                    pending.Continuation = next.ID;
+                    ready.push_back(std::move(pending));
+                }
+                return;
+            }
+        }
+
+        void Decode(
+                SPSCQueue<RawPage>& raw,
+                SPSCQueue<DecodedPage>& decoded,
+                SPSCQueue<Continuation>& continuations,
+                const std::atomic<bool>& cancelled)
+        {
+            RawPage page;
+            while (raw.Pop(page, cancelled)) {
+                DecodedPage out {page.StreamID, m_fdly.ParseEntries(page.Response)};
+
+                Continuation next {page.StreamID, out.Entries.continuation()};
+                if (not continuations.Push(next, cancelled)) {
+                    break;
+                }
+
+                if (not decoded.Push(out, cancelled)) {
+                    break;
+                }
+            }
+
+            decoded.Close();
+        }
+
+        const Fdly& m_fdly;
+        std::size_t m_capacity;
+        bool m_sortByOldest;
+        unsigned int m_count;
+        bool m_unreadOnly;
+        unsigned int m_maxPages;
+};
+
+#endif /* ifndef FDLY_PIPELINE_HEADER_SRC_H */
@@ -0,0 +1,343 @@
+/**
+ * @file
+ * Contains the PollScheduler class which decides when each subscribed feed
+ * should be polled, based on how often it updates.
+ */
+#ifndef FDLY_SCHEDULER_HEADER_SRC_H
+#define FDLY_SCHEDULER_HEADER_SRC_H
+
+#include "fdly.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+
+/**
+ * @class Adaptive per-feed polling schedule
+ *
+ * Every feed gets an estimate of its update interval, a moving average of
+ * the gaps between the update timestamps observed for it. A feed is polled
+ * twice per estimated interval, so fast moving feeds are polled often and
+ * dormant ones rarely, within configurable bounds. The number of polls is
+ * capped by a global per-minute budget; when more feeds are due than the
+ * budget allows, the most overdue go first.
+ *
+ * All times are in milliseconds since the epoch, as used by Feedly.
+ */
+class PollScheduler {
+    public:
+        using Callback = std::function<void(const std::string& feedId, Fdly::Entries& entries)>;
+
+        /**
+         * @param requestsPerMinute  maximum number of polls per minute
+         * @param minIntervalMs      shortest time between polls of a feed
+         * @param maxIntervalMs      longest time between polls of a feed
+         */
+        PollScheduler(
+                unsigned int requestsPerMinute,
+                long long minIntervalMs = 5LL * 60 * 1000,
+                long long maxIntervalMs = 24LL * 60 * 60 * 1000) :
+            m_requestsPerMinute(requestsPerMinute),
+            m_minIntervalMs(minIntervalMs),
+            m_maxIntervalMs(std::max(minIntervalMs, maxIntervalMs)),
+            m_tokens(requestsPerMinute),
+            m_lastRefillMs(0)
+        {
+            if (requestsPerMinute == 0) {
+                throw std::runtime_error("requestsPerMinute must be greater than zero");
+            }
+        }
+
+        /**
+         * Start tracking the given feeds, using their last update time as a
+         * first observation.
+         *
+         * @param feeds  feeds as returned by Fdly::GetSubscriptions
+         * @param nowMs  the current time
+         */
+        void Track(const Fdly::Feeds& feeds, long long nowMs = NowMs())
+        {
+            for (const auto& feed : feeds) {
+                Track(feed.ID, feed.Updated, nowMs);
+            }
+        }
+
+        /**
+         * Start tracking a feed. Tracking a feed again only records its
+         * update time.
+         *
+         * @param feedId     the feed's stream ID
+         * @param updatedMs  the feed's last update time, 0 if unknown
+         * @param nowMs      the current time
+         */
+        void Track(const std::string& feedId, long long updatedMs, long long nowMs = NowMs())
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto inserted = m_feeds.emplace(feedId, State {});
+            State& state = inserted.first->second;
+            if (inserted.second) {
+                state.NextPollMs = nowMs;
+                state.LastPollMs = 0;
+            }
+            ObserveLocked(state, updatedMs, nowMs);
+        }
+
+        /**
+         * Stop tracking a feed.
+         */
+        void Untrack(const std::string& feedId)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_feeds.erase(feedId);
+        }
+
+        /**
+         * Record that a feed was seen updated at a given time.
+         *
+         * @param feedId     the feed's stream ID
+         * @param updatedMs  when the feed was updated
+         * @param nowMs      the current time
+         */
+        void Observe(const std::string& feedId, long long updatedMs, long long nowMs = NowMs())
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_feeds.find(feedId);
+            if (it != m_feeds.end()) {
+                ObserveLocked(it->second, updatedMs, nowMs);
+            }
+        }
+
+        /**
+         * Return the feeds that should be polled now, within the budget.
+         *
+         * Returned feeds are considered polled and rescheduled.
+         *
+         * @param nowMs  the current time
+         */
+        std::vector<std::string> Due(long long nowMs = NowMs())
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Refill(nowMs);
+
+            std::vector<std::pair<long long, const std::string*>> due;
+            for (const auto& feed : m_feeds) {
+                if (feed.second.NextPollMs <= nowMs) {
+                    due.emplace_back(feed.second.NextPollMs, &feed.first);
+                }
+            }
+
+            // Equally overdue feeds go by ID, not by where their IDs live
+            std::size_t take = std::min(due.size(), static_cast<std::size_t>(m_tokens));
+            std::partial_sort(due.begin(), due.begin() + take, due.end(),
+                    [] (const std::pair<long long, const std::string*>& a, const std::pair<long long, const std::string*>& b) {
+                        return a.first < b.first || (a.first == b.first && *a.second < *b.second);
+                    });
+
+            std::vector<std::string> ids;
+            ids.reserve(take);
+            for (std::size_t i = 0; i < take; i++) {
+                State& state = m_feeds[*due[i].second];
+                state.LastPollMs = nowMs;
+                state.NextPollMs = nowMs + PollIntervalLocked(state, nowMs);
+                ids.push_back(*due[i].second);
+            }
+            m_tokens -= take;
+
+            return ids;
+        }
+
+        /**
+         * Return when the next feed becomes due, or 0 if no feed is tracked.
+         *
+         * This does not account for the budget; Due() may return fewer
+         * feeds than expected when it is exhausted.
+         */
+        long long NextDueMs() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            long long next = 0;
+            for (const auto& feed : m_feeds) {
+                if (next == 0 || feed.second.NextPollMs < next) {
+                    next = feed.second.NextPollMs;
+                }
+            }
+            return next;
+        }
+
+        /**
+         * Return the estimated update interval of a feed, 0 if unknown.
+         */
+        long long EstimatedIntervalMs(const std::string& feedId) const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_feeds.find(feedId);
+            return it == m_feeds.end() ? 0 : it->second.IntervalMs;
+        }
+
+        /**
+         * Poll every due feed for entries newer than its previous poll.
+         *
+         * The newest entry returned for a feed is recorded as its latest
+         * update, using its published time, or its crawl time when the
+         * published time is unknown.
+         *
+         * A feed whose request or callback fails is put back as it was
+         * before this poll, so it stays due, and the other feeds are still
+         * polled. The first failure is then rethrown.
+         *
+         * @param fdly      connection to poll with
+         * @param callback  called with the new entries of each polled feed
+         * @param count     maximum number of entries fetched per feed
+         * @param nowMs     the current time
+         *
+         * @return the number of feeds polled
+         */
+        std::size_t Poll(const Fdly& fdly, Callback callback, unsigned int count = 100, long long nowMs = NowMs())
+        {
+            std::map<std::string, State> before;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                before = m_feeds;
+            }
+
+            std::exception_ptr error;
+            auto due = Due(nowMs);
+            for (const auto& id : due) {
+                const State& previous = before[id];
+                try {
+                    auto entries = fdly.GetEntries(id, false, count, false, "",
+                            previous.LastPollMs > 0 ? static_cast<unsigned long>(previous.LastPollMs) : 0);
+
+                    long long updatedMs = NewestUpdateMs(entries);
+                    if (updatedMs > 0) {
+                        // Entries dated in the future would skew the estimate
+                        Observe(id, std::min(updatedMs, nowMs), nowMs);
+                    }
+
+                    callback(id, entries);
+                } catch (...) {
+                    Restore(id, previous);
+                    if (not error) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            return due.size();
+        }
+
+        static long long NowMs()
+        {
+            using namespace std::chrono;
+            return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+        }
+
+    private:
+        struct State {
+            long long LastUpdateMs = 0;
+            long long IntervalMs = 0;
+            long long LastPollMs = 0;
+            long long NextPollMs = 0;
+        };
+
+        /**
+         * Put a feed's poll times back to what they were before a failed
+         * poll, keeping what was learnt about its updates.
+         */
+        void Restore(const std::string& feedId, const State& previous)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_feeds.find(feedId);
+            if (it != m_feeds.end()) {
+                it->second.LastPollMs = previous.LastPollMs;
+                it->second.NextPollMs = previous.NextPollMs;
+            }
+        }
+
+        static long long NewestUpdateMs(const Fdly::Entries& entries)
+        {
+            long long newest = 0;
+            for (const auto& entry : entries) {
+                long long updatedMs = entry.Published > 0 ? entry.Published : entry.Crawled;
+                newest = std::max(newest, updatedMs);
+            }
+            return newest;
+        }
+
+        /**
+         * Weight of the newest gap in the interval estimate.
+         */
+        static constexpr double Smoothing = 0.3;
+
+        void ObserveLocked(State& state, long long updatedMs, long long nowMs)
+        {
+            if (updatedMs <= state.LastUpdateMs) {
+                return;
+            }
+
+            if (state.LastUpdateMs > 0) {
+                long long gap = updatedMs - state.LastUpdateMs;
+                if (state.IntervalMs == 0) {
+                    state.IntervalMs = gap;
+                } else {
+                    state.IntervalMs = static_cast<long long>(Smoothing * gap + (1 - Smoothing) * state.IntervalMs);
+                }
+            }
+            state.LastUpdateMs = updatedMs;
+
+            // Pull the next poll in if the feed turned out to be faster
+            long long next = std::max(state.LastPollMs, updatedMs) + PollIntervalLocked(state, nowMs);
+            if (next < state.NextPollMs) {
+                state.NextPollMs = std::max(next, nowMs);
+            }
+        }
+
+        long long PollIntervalLocked(const State& state, long long nowMs) const
+        {
+            long long interval = state.IntervalMs;
+
+            // A feed silent for longer than its usual interval is treated
+            // as slowing down
+            if (state.LastUpdateMs > 0) {
+                interval = std::max(interval, nowMs - state.LastUpdateMs);
+            }
+
+            if (interval == 0) {
+                return m_minIntervalMs;
+            }
+
+            return std::min(m_maxIntervalMs, std::max(m_minIntervalMs, interval / 2));
+        }
+
+        void Refill(long long nowMs)
+        {
+            if (m_lastRefillMs == 0) {
+                m_lastRefillMs = nowMs;
+                return;
+            }
+
+            long long elapsed = nowMs - m_lastRefillMs;
+            long long tokens = elapsed * m_requestsPerMinute / 60000;
+            if (tokens > 0) {
+                m_tokens = std::min<long long>(m_requestsPerMinute, m_tokens + tokens);
+                m_lastRefillMs += tokens * 60000 / m_requestsPerMinute;
+            }
+        }
+
+        const unsigned int m_requestsPerMinute;
+        const long long m_minIntervalMs;
+        const long long m_maxIntervalMs;
+
+        mutable std::mutex m_mutex;
+        std::map<std::string, State> m_feeds;
+        long long m_tokens;
+        long long m_lastRefillMs;
+};
+
+#endif /* ifndef FDLY_SCHEDULER_HEADER_SRC_H */
@@ -0,0 +1,132 @@
+#include "fdly_accounts.hpp"
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <future>
+#include <thread>
+
+using namespace std;
+
+/**
+ * HTTP server on the loopback interface answering a single request, but
+ * only once released.
+ */
+class HeldServer {
+    public:
+        explicit HeldServer(const string& body) :
+            m_socket(socket(AF_INET, SOCK_STREAM, 0))
+        {
+            sockaddr_in address {};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t length = sizeof(address);
+            if (bind(m_socket, reinterpret_cast<sockaddr*>(&address), length) != 0
+                    || listen(m_socket, 1) != 0
+                    || getsockname(m_socket, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+                throw runtime_error("Could not start the test server");
+            }
+            m_port = ntohs(address.sin_port);
+
+            m_thread = thread([this, body] {
+                int client = accept(m_socket, nullptr, nullptr);
+                string request;
+                char buffer[1024];
+                while (request.find("\r\n\r\n") == string::npos) {
+                    ssize_t n = read(client, buffer, sizeof(buffer));
+                    if (n <= 0) {
+                        break;
+                    }
+                    request.append(buffer, n);
+                }
+                m_received.set_value();
+
+                m_release.get_future().wait();
+                string response = "HTTP/1.1 200 OK\r\nContent-Length: " + to_string(body.size())
+                        + "\r\nConnection: close\r\n\r\n" + body;
+                ssize_t written = write(client, response.data(), response.size());
+                (void)written;
+                close(client);
+            });
+        }
+
+        ~HeldServer()
+        {
+            Release();
+            m_thread.join();
+            close(m_socket);
+        }
+
+        string Url() const
+        {
+            return "http://127.0.0.1:" + to_string(m_port);
+        }
+
+        void WaitForRequest()
+        {
+            m_received.get_future().wait();
+        }
+
+        void Release()
+        {
+            if (not m_released) {
+                m_released = true;
+                m_release.set_value();
+            }
+        }
+
+    private:
+        int m_socket;
+        int m_port = 0;
+        bool m_released = false;
+        promise<void> m_received;
+        promise<void> m_release;
+        thread m_thread;
+};
+
+TEST(AccountsTests, RemovingAnAccountWithARequestInFlight)
+{
+    HeldServer server(R"([{"label":"tech","id":"user/u/category/tech"}])");
+
+    FdlyAccounts accounts(1, 10, 1);
+    Fdly::User user {"u", "token"};
+    Fdly::Options options;
+    options.BaseUrl = server.Url();
+    auto account = accounts.Add(user, options);
+
+    auto categories = accounts.GetCategories(account);
+    server.WaitForRequest();
+
+    accounts.Remove(account);
+    EXPECT_EQ(accounts.size(), 0u);
+    EXPECT_THROW(accounts.GetCategories(account), runtime_error);
+
+    // Parsing the response still has the account's connection to use
+    server.Release();
+    auto result = categories.get();
+    ASSERT_EQ(result.size(), 1u);
+    EXPECT_EQ(result.getByLabel("tech").ID, "user/u/category/tech");
+}
+
+TEST(AccountsTests, RemovingAnAccountFailsItsQueuedRequests)
+{
+    HeldServer server("[]");
+
+    // A single request in flight at a time: the second one waits in the queue
+    FdlyAccounts accounts(1, 1, 1);
+    Fdly::User user {"u", "token"};
+    Fdly::Options options;
+    options.BaseUrl = server.Url();
+    auto account = accounts.Add(user, options);
+
+    auto sent = accounts.GetCategories(account);
+    auto queued = accounts.GetSubscriptions(account);
+    server.WaitForRequest();
+
+    accounts.Remove(account);
+    EXPECT_THROW(queued.get(), runtime_error);
+
+    server.Release();
+    EXPECT_EQ(sent.get().size(), 0u);
+}
@@ -0,0 +1,188 @@
+#include "fdly.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <map>
+#include <thread>
+
+using namespace std;
+
+/**
+ * Connection whose streams each hold one entry named after the stream, and
+ * which counts the pages it fetches per stream.
+ */
+class CacheTests : public testing::Test {
+    public:
+        CacheTests() :
+            m_user {"u", "token"},
+            m_latency(0),
+            m_fail(false)
+        {
+            Fdly::Options options;
+            options.Transport = [this] (const char* method, const string& url, const cpr::Header&, const string&) {
+                cpr::Response r;
+                r.status_code = 200;
+                if (string(method) == "POST") {
+                    return r;
+                }
+
+                this_thread::sleep_for(chrono::milliseconds(m_latency));
+                if (m_fail) {
+                    throw runtime_error("connection reset");
+                }
+
+                auto begin = url.find("streamId=") + 9;
+                string stream = url.substr(begin, url.find('&', begin) - begin);
+                lock_guard<mutex> lock(m_mutex);
+                m_fetches[stream]++;
+
+                string id = stream;
+                for (auto slash = id.find("%2F"); slash != string::npos; slash = id.find("%2F")) {
+                    id.replace(slash, 3, "/");
+                }
+                r.text = "{\"items\":[{\"id\":\"" + id + "/entry\",\"title\":\"t\",\"originId\":\"o\"}]}";
+                return r;
+            };
+            m_fdly.reset(new Fdly(m_user, options));
+        }
+
+        void FetchAll()
+        {
+            for (const char* stream : {"All", "user/u/category/tech", "user/u/category/design", "feed/a"}) {
+                m_fdly->GetEntries(stream);
+            }
+        }
+
+        Fdly::User m_user;
+        unique_ptr<Fdly> m_fdly;
+        mutex m_mutex;
+        map<string, int> m_fetches;
+        int m_latency;
+        atomic<bool> m_fail;
+};
+
+TEST_F(CacheTests, DisabledByDefault)
+{
+    m_fdly->GetEntries("feed/a");
+    m_fdly->GetEntries("feed/a");
+    EXPECT_EQ(m_fetches["feed%2Fa"], 2);
+    EXPECT_EQ(m_fdly->GetEntriesCacheStats().Pages, 0u);
+}
+
+TEST_F(CacheTests, ServesRepeatedPages)
+{
+    m_fdly->SetEntriesCacheBudget(1 << 20);
+    m_fdly->GetEntries("feed/a");
+    auto again = m_fdly->GetEntries("feed/a");
+    ASSERT_EQ(again.size(), 1u);
+    EXPECT_EQ((*again.begin()).ID, "feed/a/entry");
+    EXPECT_EQ(m_fetches["feed%2Fa"], 1);
+
+    // Other parameters are other pages
+    m_fdly->GetEntries("feed/a", true);
+    m_fdly->GetEntries("feed/a", false, 20, true, "", 0, Fdly::ContentFormat::TEXT);
+    EXPECT_EQ(m_fetches["feed%2Fa"], 3);
+
+    auto stats = m_fdly->GetEntriesCacheStats();
+    EXPECT_EQ(stats.Hits, 1u);
+    EXPECT_EQ(stats.Misses, 3u);
+    EXPECT_EQ(stats.Pages, 3u);
+
+    // A budget too small for two pages keeps the most recent one
+    m_fdly->SetEntriesCacheBudget(stats.Bytes / 2);
+    EXPECT_EQ(m_fdly->GetEntriesCacheStats().Pages, 1u);
+}
+
+TEST_F(CacheTests, PagesExpire)
+{
+    m_fdly->SetEntriesCacheBudget(1 << 20, chrono::milliseconds(50));
+    m_fdly->GetEntries("feed/a");
+    m_fdly->GetEntries("feed/a");
+    EXPECT_EQ(m_fetches["feed%2Fa"], 1);
+
+    this_thread::sleep_for(chrono::milliseconds(80));
+    m_fdly->GetEntries("feed/a");
+    EXPECT_EQ(m_fetches["feed%2Fa"], 2);
+    EXPECT_EQ(m_fdly->GetEntriesCacheStats().Pages, 1u);
+}
+
+TEST_F(CacheTests, MarkingACategoryDropsEveryPage)
+{
+    m_fdly->SetEntriesCacheBudget(1 << 20);
+    FetchAll();
+    m_fdly->MarkCategoryAs("user/u/category/tech", Fdly::Category::Action::READ);
+    FetchAll();
+
+    // The feed may belong to the category, and the other category share it
+    for (const auto& fetches : m_fetches) {
+        EXPECT_EQ(fetches.second, 2) << fetches.first;
+    }
+}
+
+TEST_F(CacheTests, MarkingEntriesDropsTheStreamsHoldingThem)
+{
+    m_fdly->SetEntriesCacheBudget(1 << 20);
+    FetchAll();
+    m_fdly->MarkEntriesWithAction({"feed/a/entry"}, Fdly::Entry::Action::READ);
+    FetchAll();
+
+    EXPECT_EQ(m_fetches["feed%2Fa"], 2);
+    EXPECT_EQ(m_fetches["user%2Fu%2Fcategory%2Fglobal.all"], 1);
+    EXPECT_EQ(m_fetches["user%2Fu%2Fcategory%2Ftech"], 1);
+
+    m_fdly->InvalidateEntriesCache("All");
+    m_fdly->GetEntries("All");
+    m_fdly->GetEntries("user/u/category/tech");
+    EXPECT_EQ(m_fetches["user%2Fu%2Fcategory%2Fglobal.all"], 2);
+    EXPECT_EQ(m_fetches["user%2Fu%2Fcategory%2Ftech"], 1);
+}
+
+TEST_F(CacheTests, ConcurrentRequestsAreCoalesced)
+{
+    m_latency = 200;
+    vector<Fdly::Entries> results(4);
+    vector<thread> threads;
+    for (auto& result : results) {
+        threads.emplace_back([this, &result] {
+            result = m_fdly->GetEntries("feed/a");
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(m_fetches["feed%2Fa"], 1);
+    for (auto& result : results) {
+        ASSERT_EQ(result.size(), 1u);
+        EXPECT_EQ((*result.begin()).ID, "feed/a/entry");
+    }
+
+    // Once done, the next request is sent again
+    m_latency = 0;
+    m_fdly->GetEntries("feed/a");
+    EXPECT_EQ(m_fetches["feed%2Fa"], 2);
+}
+
+TEST_F(CacheTests, CoalescedRequestsShareTheError)
+{
+    m_latency = 200;
+    m_fail = true;
+    atomic<int> failures(0);
+    vector<thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([this, &failures] {
+            try {
+                m_fdly->GetEntries("feed/a");
+            } catch (const runtime_error&) {
+                failures++;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(failures.load(), 4);
+
+    m_latency = 0;
+    m_fail = false;
+    EXPECT_EQ(m_fdly->GetEntries("feed/a").size(), 1u);
+}
@@ -0,0 +1,115 @@
+#include "fdly_columnar.hpp"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+using namespace std;
+
+static const size_t g_headerSize = 32;
+
+/**
+ * Snapshots are written to and read back from a temporary file.
+ */
+class ColumnarTests : public testing::Test {
+    public:
+        ColumnarTests() :
+            m_path(testing::TempDir() + "fdly_columnar_test.bin")
+        {
+            Fdly::StringPool pool;
+            for (int i = 0; i < 3; i++) {
+                string n = to_string(i);
+                m_entries.emplace_back("<p>content " + n + "</p>", "title " + n, "entry/" + n,
+                                       pool.Intern("http://origin/" + n), pool.Intern(""));
+                m_entries.back().Published = 1000 + i;
+                m_entries.back().Crawled = 2000 + i;
+            }
+        }
+
+        ~ColumnarTests()
+        {
+            remove(m_path.c_str());
+        }
+
+        string WrittenBytes()
+        {
+            EntriesSnapshot::FromEntries(m_entries).Write(m_path);
+            ifstream in(m_path, ios::binary);
+            return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        }
+
+        void Overwrite(const string& bytes)
+        {
+            ofstream(m_path, ios::binary | ios::trunc) << bytes;
+        }
+
+        void SetWord(string& bytes, size_t offset, uint64_t value)
+        {
+            memcpy(&bytes[offset], &value, sizeof(value));
+        }
+
+        string m_path;
+        Fdly::Entries m_entries;
+};
+
+TEST_F(ColumnarTests, WriteThenMap)
+{
+    EntriesSnapshot::FromEntries(m_entries).Write(m_path);
+    auto snapshot = EntriesSnapshot::Map(m_path);
+
+    ASSERT_EQ(snapshot.size(), 3u);
+    EXPECT_TRUE(snapshot.IDs()[0] == "entry/0");
+    EXPECT_TRUE(snapshot.Titles()[2] == "title 2");
+    EXPECT_TRUE(snapshot.OriginURLs()[1] == "http://origin/1");
+    EXPECT_TRUE(snapshot.OriginTitles()[1] == "");
+    EXPECT_EQ(snapshot.Contents()[2].str(), "<p>content 2</p>");
+    EXPECT_EQ(snapshot.Published()[1], 1001);
+    EXPECT_EQ(snapshot.Crawled()[2], 2002);
+
+    Fdly::Entries none;
+    EntriesSnapshot::FromEntries(none).Write(m_path);
+    EXPECT_TRUE(EntriesSnapshot::Map(m_path).empty());
+}
+
+TEST_F(ColumnarTests, CorruptFilesAreRejected)
+{
+    const string good = WrittenBytes();
+    const size_t ids = g_headerSize;
+
+    auto rejected = [this] (const string& bytes) {
+        Overwrite(bytes);
+        EXPECT_THROW(EntriesSnapshot::Map(m_path), runtime_error);
+    };
+
+    rejected(good.substr(0, g_headerSize - 1));
+    rejected(good.substr(0, good.size() - 8));
+
+    string bytes = good;
+    bytes[0] = 'X';
+    rejected(bytes);
+
+    // Counts whose offset arrays would overflow or exceed the file
+    for (uint64_t count : {uint64_t(-1), uint64_t(-1) / 8, uint64_t(1) << 40, uint64_t(good.size() / 8)}) {
+        bytes = good;
+        SetWord(bytes, 8, count);
+        rejected(bytes);
+    }
+
+    // An offset past the end of the file
+    bytes = good;
+    SetWord(bytes, ids + 3 * 8, uint64_t(1) << 62);
+    rejected(bytes);
+
+    // Offsets going backwards, or not starting at zero
+    bytes = good;
+    SetWord(bytes, ids + 1 * 8, 5);
+    SetWord(bytes, ids + 2 * 8, 2);
+    rejected(bytes);
+
+    bytes = good;
+    SetWord(bytes, ids, 1);
+    rejected(bytes);
+
+    Overwrite(good);
+    EXPECT_EQ(EntriesSnapshot::Map(m_path).size(), 3u);
+}
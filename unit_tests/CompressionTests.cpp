@@ -0,0 +1,128 @@
+#include "fdly.hpp"
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+using namespace std;
+
+static const string g_categories =
+    R"([{"label":"tech","id":"user/u/category/tech"},{"label":"design","id":"user/u/category/design"}])";
+
+/**
+ * Compress with zlib: 15 + 16 window bits for gzip, 15 for the zlib wrapper
+ * and -15 for raw deflate.
+ */
+static string compress(const string& data, int windowBits)
+{
+    z_stream stream {};
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw runtime_error("Could not initialize zlib");
+    }
+
+    string out(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = out.size();
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    return out;
+}
+
+class CompressionTests : public testing::Test {
+    public:
+        CompressionTests() :
+            m_user {"u", "token"}
+        {
+        }
+
+        /**
+         * Connection whose requests are all answered with the given body and
+         * Content-Encoding.
+         */
+        unique_ptr<Fdly> Connect(const string& body, const string& encoding)
+        {
+            Fdly::Options options;
+            options.Transport = [this, body, encoding] (const char*, const string&, const cpr::Header& header, const string&) {
+                m_acceptEncoding = header.count("Accept-Encoding") ? header.at("Accept-Encoding") : "";
+                cpr::Response r;
+                r.status_code = 200;
+                r.text = body;
+                if (not encoding.empty()) {
+                    r.header["Content-Encoding"] = encoding;
+                }
+                return r;
+            };
+            return unique_ptr<Fdly>(new Fdly(m_user, options));
+        }
+
+        Fdly::User m_user;
+        string m_acceptEncoding;
+};
+
+TEST_F(CompressionTests, DecodesEveryDeflateFormat)
+{
+    const pair<int, const char*> formats[] = {
+        {15 + 16, "gzip"},
+        {15, "deflate"},
+        {-15, "deflate"},
+        // Some servers label a gzip body as deflate
+        {15 + 16, "deflate"}
+    };
+
+    for (const auto& format : formats) {
+        string body = compress(g_categories, format.first);
+        auto connection = Connect(body, format.second);
+
+        auto categories = connection->GetCategories();
+        ASSERT_EQ(categories.size(), 2u) << format.second << " " << format.first;
+        EXPECT_EQ(categories.getByLabel("tech").ID, "user/u/category/tech");
+
+        auto stats = connection->GetTransferStats();
+        EXPECT_EQ(stats.Responses, 1u);
+        EXPECT_EQ(stats.CompressedBytes, body.size());
+        EXPECT_EQ(stats.UncompressedBytes, g_categories.size());
+    }
+}
+
+TEST_F(CompressionTests, LargeBodyIsInflatedInChunks)
+{
+    string content(200000, 'x');
+    for (size_t i = 0; i < content.size(); i += 7) {
+        content[i] = 'a' + i % 26;
+    }
+    string page = R"({"items":[{"id":"e1","title":"t","originId":"o","summary":{"content":")" + content + R"("}}]})";
+
+    auto connection = Connect(compress(page, 15 + 16), "gzip");
+    auto entries = connection->GetEntries("All");
+
+    ASSERT_EQ(entries.size(), 1u);
+    EXPECT_EQ((*entries.begin()).Content, content);
+    EXPECT_EQ(connection->GetTransferStats().UncompressedBytes, page.size());
+}
+
+TEST_F(CompressionTests, IdentityAndHeaders)
+{
+    auto connection = Connect(g_categories, "");
+    EXPECT_EQ(connection->GetCategories().size(), 2u);
+    EXPECT_FALSE(m_acceptEncoding.empty());
+
+    auto stats = connection->GetTransferStats();
+    EXPECT_EQ(stats.CompressedBytes, stats.UncompressedBytes);
+
+    connection->ResetTransferStats();
+    connection->SetCompression(false);
+    connection->GetCategories(nullptr);
+    EXPECT_TRUE(m_acceptEncoding.empty());
+    EXPECT_EQ(connection->GetTransferStats().Responses, 1u);
+}
+
+TEST_F(CompressionTests, CorruptBodiesThrow)
+{
+    string gzip = compress(g_categories, 15 + 16);
+
+    EXPECT_THROW(Connect(gzip.substr(0, gzip.size() / 2), "gzip")->GetCategories(), runtime_error);
+    EXPECT_THROW(Connect("not compressed at all", "deflate")->GetCategories(), runtime_error);
+    EXPECT_THROW(Connect(g_categories, "compress")->GetCategories(), runtime_error);
+}
@@ -0,0 +1,238 @@
+#include "fdly_coro.hpp"
+#include <gtest/gtest.h>
+
+#ifdef FDLY_HAS_COROUTINES
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+/**
+ * HTTP/1.1 server on the loopback interface answering the requests of every
+ * connection, each connection on its own thread, with what the handler
+ * returns for their target.
+ */
+class LoopbackServer {
+    public:
+        struct Reply {
+            int    Status;
+            string Body;
+            int    DelayMs;
+        };
+
+        explicit LoopbackServer(function<Reply(const string&)> handler) :
+            m_socket(socket(AF_INET, SOCK_STREAM, 0)),
+            m_handler(move(handler))
+        {
+            sockaddr_in address {};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t length = sizeof(address);
+            if (bind(m_socket, reinterpret_cast<sockaddr*>(&address), length) != 0
+                    || listen(m_socket, 16) != 0
+                    || getsockname(m_socket, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+                throw runtime_error("Could not start the test server");
+            }
+            m_port = ntohs(address.sin_port);
+
+            m_thread = thread([this] {
+                int client;
+                while ((client = accept(m_socket, nullptr, nullptr)) >= 0) {
+                    lock_guard<mutex> lock(m_mutex);
+                    m_clients.emplace_back(&LoopbackServer::Answer, this, client);
+                }
+            });
+        }
+
+        ~LoopbackServer()
+        {
+            shutdown(m_socket, SHUT_RDWR);
+            m_thread.join();
+            close(m_socket);
+            for (auto& client : m_clients) {
+                client.join();
+            }
+        }
+
+        string Url() const
+        {
+            return "http://127.0.0.1:" + to_string(m_port);
+        }
+
+    private:
+        void Answer(int client)
+        {
+            string received;
+            char buffer[1024];
+            while (true) {
+                auto end = received.find("\r\n\r\n");
+                if (end == string::npos) {
+                    ssize_t n = read(client, buffer, sizeof(buffer));
+                    if (n <= 0) {
+                        break;
+                    }
+                    received.append(buffer, n);
+                    continue;
+                }
+
+                // "GET /target HTTP/1.1", the tests send no request bodies
+                auto begin = received.find(' ') + 1;
+                Reply reply = m_handler(received.substr(begin, received.find(' ', begin) - begin));
+                received.erase(0, end + 4);
+                this_thread::sleep_for(chrono::milliseconds(reply.DelayMs));
+
+                string response = "HTTP/1.1 " + to_string(reply.Status) + " X\r\nContent-Length: "
+                        + to_string(reply.Body.size()) + "\r\n\r\n" + reply.Body;
+                if (write(client, response.data(), response.size()) < 0) {
+                    break;
+                }
+            }
+            close(client);
+        }
+
+        int m_socket;
+        int m_port = 0;
+        function<Reply(const string&)> m_handler;
+        mutex m_mutex;
+        vector<thread> m_clients;
+        thread m_thread;
+};
+
+/**
+ * Awaitable API over a connection to a loopback server.
+ */
+class CoroTests : public testing::Test {
+    public:
+        void Start(function<LoopbackServer::Reply(const string&)> handler)
+        {
+            m_server.reset(new LoopbackServer(move(handler)));
+            Fdly::Options options;
+            options.BaseUrl = m_server->Url();
+            m_fdly.reset(new Fdly(m_user, options));
+            m_api.reset(new FdlyAsync(*m_fdly, m_loop));
+        }
+
+        // The loop is stopped before the server, which may still be
+        // answering requests nobody awaits anymore
+        unique_ptr<LoopbackServer> m_server;
+        Fdly::User m_user {"u", "token"};
+        unique_ptr<Fdly> m_fdly;
+        FdlyLoop m_loop {2};
+        unique_ptr<FdlyAsync> m_api;
+};
+
+static FdlyAsync::Task<Fdly::Categories> Categories(FdlyAsync& api)
+{
+    co_return co_await api.Categories();
+}
+
+static FdlyAsync::Task<string> CategoriesError(FdlyAsync& api)
+{
+    try {
+        co_await api.Categories();
+    } catch (const runtime_error& e) {
+        co_return string(e.what());
+    }
+    co_return string();
+}
+
+static FdlyAsync::Task<string> FirstEntry(FdlyAsync& api, string stream, mutex& mutex, vector<string>& finished)
+{
+    auto entries = co_await api.Entries(stream);
+    {
+        lock_guard<std::mutex> lock(mutex);
+        finished.push_back(stream);
+    }
+    co_return (*entries.begin()).ID;
+}
+
+static FdlyAsync::Task<int> Throws()
+{
+    throw runtime_error("before any request");
+    co_return 0;
+}
+
+static FdlyAsync::Task<void> ThrowsAfterAwaiting(FdlyAsync& api)
+{
+    co_await api.Categories();
+    throw runtime_error("after the request");
+}
+
+TEST_F(CoroTests, AwaitReturnsParsedData)
+{
+    Start([] (const string& target) {
+        if (target.find("/categories") == string::npos) {
+            return LoopbackServer::Reply {404, "", 0};
+        }
+        return LoopbackServer::Reply {200, R"([{"label":"tech","id":"user/u/category/tech"}])", 0};
+    });
+
+    auto categories = FdlyAsync::SyncWait(Categories(*m_api));
+    ASSERT_EQ(categories.size(), 1u);
+    EXPECT_EQ(categories.getByLabel("tech").ID, "user/u/category/tech");
+}
+
+TEST_F(CoroTests, HttpErrorIsRethrownAtTheAwait)
+{
+    Start([] (const string&) {
+        return LoopbackServer::Reply {500, "", 0};
+    });
+
+    EXPECT_EQ(FdlyAsync::SyncWait(CategoriesError(*m_api)), "Could not get categories: 500");
+}
+
+TEST_F(CoroTests, WhenAllKeepsArgumentOrder)
+{
+    // The first stream answers last and the last one first
+    Start([] (const string& target) {
+        if (target.find("/categories") != string::npos) {
+            return LoopbackServer::Reply {200, "[]", 0};
+        }
+        auto begin = target.find("streamId=") + 9;
+        string stream = target.substr(begin, target.find('&', begin) - begin);
+        int delay = stream == "a" ? 400 : stream == "b" ? 200 : 0;
+        return LoopbackServer::Reply {200, R"({"items":[{"id":")" + stream + R"(/entry","title":"t","originId":"o"}]})", delay};
+    });
+
+    // Requests wait for the first connection to the host to tell whether
+    // they can share it, so open it first: requests sent while it is busy
+    // then go out on connections of their own
+    FdlyAsync::SyncWait(Categories(*m_api));
+
+    mutex mutex;
+    vector<string> finished;
+    vector<FdlyAsync::Task<string>> tasks;
+    for (const char* stream : {"a", "b", "c"}) {
+        tasks.push_back(FirstEntry(*m_api, stream, mutex, finished));
+    }
+
+    auto ids = FdlyAsync::SyncWait(FdlyAsync::WhenAll(move(tasks)));
+    EXPECT_EQ(ids, vector<string>({"a/entry", "b/entry", "c/entry"}));
+    EXPECT_EQ(finished, vector<string>({"c", "b", "a"}));
+}
+
+TEST_F(CoroTests, SyncWaitRethrows)
+{
+    Start([] (const string&) {
+        return LoopbackServer::Reply {200, "[]", 0};
+    });
+
+    EXPECT_THROW(FdlyAsync::SyncWait(Throws()), runtime_error);
+    EXPECT_THROW(FdlyAsync::SyncWait(ThrowsAfterAwaiting(*m_api)), runtime_error);
+}
+
+#else
+
+TEST(CoroTests, RequiresCpp20)
+{
+    GTEST_SKIP() << "Coroutines need C++20, configure with -DBUILD_FDLY_CPP20_TESTS=ON";
+}
+
+#endif
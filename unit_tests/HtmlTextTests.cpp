@@ -0,0 +1,100 @@
+#include "fdly_html.hpp"
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace std;
+
+TEST(HtmlTextTests, Whitespace)
+{
+    EXPECT_EQ(HtmlText::Extract(" hello  world "), "hello world");
+    EXPECT_EQ(HtmlText::Extract("\n\t hello\r\nworld\t"), "hello world");
+    EXPECT_EQ(HtmlText::Extract("<p> hello </p>  <p>\tworld</p> "), "hello world");
+    EXPECT_EQ(HtmlText::Extract("   "), "");
+    EXPECT_EQ(HtmlText::Extract(""), "");
+}
+
+TEST(HtmlTextTests, Tags)
+{
+    EXPECT_EQ(HtmlText::Extract("<p>one</p><p>two</p>"), "one two");
+    EXPECT_EQ(HtmlText::Extract("a<br/>b<IMG SRC=\"x.png\">c"), "a b c");
+    // Inline formatting does not split words
+    EXPECT_EQ(HtmlText::Extract("un<b>believ</b><EM>able</EM> <a href=\"x\">link</a>"), "unbelievable link");
+    EXPECT_EQ(HtmlText::Extract("a<!-- <p>hidden</p> -->b<!DOCTYPE html><?xml version=\"1.0\"?>c"), "ab c");
+    EXPECT_EQ(HtmlText::Extract("text <p unterminated"), "text");
+}
+
+TEST(HtmlTextTests, GreaterThanInQuotedAttributes)
+{
+    EXPECT_EQ(HtmlText::Extract("<a title=\"a > b\">link</a> text"), "link text");
+    EXPECT_EQ(HtmlText::Extract("x<img alt='x>y' src=\"i.png\">y"), "x y");
+    EXPECT_EQ(HtmlText::Extract("<p class = \"c\" data-x=\"1>2\" hidden>a</p>"), "a");
+    // Quotes that do not start a value are part of the tag
+    EXPECT_EQ(HtmlText::Extract("<p it's>a</p>b"), "a b");
+    EXPECT_EQ(HtmlText::Extract("text <p title=\"never closed>more"), "text");
+}
+
+TEST(HtmlTextTests, LiteralLessThan)
+{
+    EXPECT_EQ(HtmlText::Extract("1 < 2 and 3 > 2 ok"), "1 < 2 and 3 > 2 ok");
+    EXPECT_EQ(HtmlText::Extract("a<=b, x <3, <"), "a<=b, x <3, <");
+    EXPECT_EQ(HtmlText::Extract("<<b>x</b>"), "<x");
+}
+
+TEST(HtmlTextTests, ScriptAndStyleAreSkipped)
+{
+    EXPECT_EQ(HtmlText::Extract("a<script>var s = '<p>not text</p>';</script>b"), "a b");
+    EXPECT_EQ(HtmlText::Extract("a<SCRIPT type=\"x\">1 < 2</Script >b"), "a b");
+    EXPECT_EQ(HtmlText::Extract("<style>p { color: red; }</style>visible"), "visible");
+    EXPECT_EQ(HtmlText::Extract("a<script>never closed"), "a");
+}
+
+TEST(HtmlTextTests, Entities)
+{
+    EXPECT_EQ(HtmlText::Extract("Q&amp;A &lt;tag&gt; &quot;x&quot; &apos;y&apos;"), "Q&A <tag> \"x\" 'y'");
+    EXPECT_EQ(HtmlText::Extract("caf&#233; &#x2603; &#X1F600;"), "caf\xC3\xA9 \xE2\x98\x83 \xF0\x9F\x98\x80");
+    EXPECT_EQ(HtmlText::Extract("a&nbsp;&nbsp;b&#160;c&#10;d"), "a b c d");
+    EXPECT_EQ(HtmlText::Extract("&unknown; &amp &#xZZ; &#; &#-1;"), "&unknown; &amp &#xZZ; &#; &#-1;");
+    EXPECT_EQ(HtmlText::Extract("&#0;&#xD800;&#x110000;"), "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD");
+}
+
+TEST(HtmlTextTests, NamedEntities)
+{
+    EXPECT_EQ(HtmlText::Extract("it&rsquo;s &ldquo;done&rdquo; &mdash; &hellip;"),
+            "it\xE2\x80\x99s \xE2\x80\x9C" "done\xE2\x80\x9D \xE2\x80\x94 \xE2\x80\xA6");
+    EXPECT_EQ(HtmlText::Extract("caf&eacute; &Eacute;t&eacute; &copy; &euro;5 &trade;"),
+            "caf\xC3\xA9 \xC3\x89t\xC3\xA9 \xC2\xA9 \xE2\x82\xAC" "5 \xE2\x84\xA2");
+    EXPECT_EQ(HtmlText::Extract("&AElig;&yuml;&szlig;&ndash;&bull;"),
+            "\xC3\x86\xC3\xBF\xC3\x9F\xE2\x80\x93\xE2\x80\xA2");
+
+    // Names are case sensitive and spaces of any width collapse
+    EXPECT_EQ(HtmlText::Extract("&Mdash; &bogus; &eacute"), "&Mdash; &bogus; &eacute");
+    EXPECT_EQ(HtmlText::Extract("a&ensp;&emsp;b&thinsp;c"), "a b c");
+}
+
+TEST(HtmlTextTests, ScalarScanMatches)
+{
+    static const char* const pieces[] = {
+        "word", " ", "  ", "\n", "\t", "<p>", "</p>", "<b>", "</b>", "&amp;", "&#8217;", "&bogus",
+        "<", " < ", ">", "<!-- c -->", "<script>x</script>", "caf\xC3\xA9", "0123456789abcdef"
+    };
+
+    mt19937 rng(7);
+    for (int i = 0; i < 2000; i++) {
+        string html;
+        int length = rng() % 60;
+        for (int j = 0; j < length; j++) {
+            html += pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))];
+        }
+        ASSERT_EQ(HtmlText::Extract(html), HtmlText::ExtractScalar(html)) << html;
+    }
+}
+
+TEST(HtmlTextTests, Snippet)
+{
+    EXPECT_EQ(HtmlText::Snippet("short", 10), "short");
+    EXPECT_EQ(HtmlText::Snippet("hello wonderful world", 18), "hello wonderful\xE2\x80\xA6");
+    EXPECT_EQ(HtmlText::Snippet("hello wonderful world", 14), "hello wonde\xE2\x80\xA6");
+    // Never cuts inside a UTF-8 sequence
+    EXPECT_EQ(HtmlText::Snippet("\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9", 6), "\xC3\xA9\xE2\x80\xA6");
+    EXPECT_EQ(HtmlText::Snippet("abcdef", 2), "");
+}
@@ -0,0 +1,73 @@
+#include "fdly_loop.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+using namespace std;
+
+/**
+ * Requests read a local file, so that the loop runs without network access.
+ */
+class LoopTests : public testing::Test {
+    public:
+        LoopTests() :
+            m_path(testing::TempDir() + "fdly_loop_test.json")
+        {
+            ofstream(m_path) << "{\"ok\":true}";
+        }
+
+        ~LoopTests()
+        {
+            remove(m_path.c_str());
+        }
+
+        string Url() const
+        {
+            return "file://" + m_path;
+        }
+
+        string m_path;
+};
+
+TEST_F(LoopTests, CallbackExceptionsReachTheFuture)
+{
+    FdlyLoop loop(1);
+
+    auto failed = loop.Get(Url(), {}, [] (cpr::Response) {
+        throw runtime_error("parse failed");
+    });
+    EXPECT_THROW(failed.get(), runtime_error);
+
+    // The worker survived and keeps serving requests
+    string body;
+    loop.Get(Url(), {}, [&] (cpr::Response r) {
+        body = r.text;
+    }).get();
+    EXPECT_EQ(body, "{\"ok\":true}");
+
+    EXPECT_THROW(loop.Dispatch([] { throw logic_error("task failed"); }).get(), logic_error);
+    EXPECT_NO_THROW(loop.Dispatch([] {}).get());
+}
+
+TEST_F(LoopTests, SubmittingWhileStoppingFailsTheCallback)
+{
+    unique_ptr<FdlyLoop> loop(new FdlyLoop(1));
+    FdlyLoop* raw = loop.get();
+    atomic<bool> stopping(false);
+
+    auto done = loop->Get(Url(), {}, [&] (cpr::Response) {
+        while (not stopping) {
+            this_thread::yield();
+        }
+        // Give the destructor time to refuse new requests
+        this_thread::sleep_for(chrono::milliseconds(50));
+        raw->Get(Url(), {}, [] (cpr::Response) {});
+    });
+
+    stopping = true;
+    loop.reset();
+
+    EXPECT_THROW(done.get(), runtime_error);
+}
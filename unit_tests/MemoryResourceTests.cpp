@@ -0,0 +1,124 @@
+#include "fdly.hpp"
+#include <gtest/gtest.h>
+
+using namespace std;
+
+#ifdef FDLY_HAS_PMR
+
+/**
+ * Resource counting what it hands out before passing it on upstream.
+ */
+class CountingResource : public std::pmr::memory_resource {
+    public:
+        explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) :
+            m_upstream(upstream)
+        {
+        }
+
+        size_t m_allocations = 0;
+        size_t m_live = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            m_allocations++;
+            m_live++;
+            return m_upstream->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override
+        {
+            m_live--;
+            m_upstream->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+        std::pmr::memory_resource* m_upstream;
+};
+
+/**
+ * Connection answering every request with m_body.
+ */
+class MemoryResourceTests : public testing::Test {
+    public:
+        MemoryResourceTests() :
+            m_user {"u", "token"}
+        {
+            Fdly::Options options;
+            options.Transport = [this] (const char*, const string&, const cpr::Header&, const string&) {
+                cpr::Response r;
+                r.status_code = 200;
+                r.text = m_body;
+                return r;
+            };
+            m_fdly.reset(new Fdly(m_user, options));
+        }
+
+        Fdly::User m_user;
+        unique_ptr<Fdly> m_fdly;
+        string m_body;
+};
+
+TEST_F(MemoryResourceTests, FeedsAndTheirCategoriesUseTheResource)
+{
+    m_body = "[";
+    for (int i = 0; i < 20; i++) {
+        m_body += string(i ? "," : "") + R"({"id":"feed/)" + to_string(i) + R"(","title":"t","website":"w","visualUrl":"v",)"
+                + R"("categories":[{"label":"a","id":"user/u/category/a"},{"label":"b","id":"user/u/category/b"}]})";
+    }
+    m_body += "]";
+
+    CountingResource counting;
+    {
+        auto feeds = m_fdly->GetSubscriptions(&counting);
+        ASSERT_EQ(feeds.size(), 20u);
+        EXPECT_EQ((*feeds.begin()).Categories.size(), 2u);
+
+        // One array for the feeds, one node per category of every feed
+        EXPECT_EQ(counting.m_allocations, 1u + 20 * 2);
+    }
+    EXPECT_EQ(counting.m_live, 0u);
+}
+
+TEST_F(MemoryResourceTests, EntriesUseTheResource)
+{
+    m_body = R"({"items":[)";
+    for (int i = 0; i < 100; i++) {
+        m_body += string(i ? "," : "") + R"({"id":"e)" + to_string(i) + R"(","title":"t","originId":"o"})";
+    }
+    m_body += "]}";
+
+    CountingResource direct;
+    {
+        auto page = m_fdly->GetEntries("All", false, 100, false, "", 0, Fdly::ContentFormat::HTML, &direct);
+        ASSERT_EQ(page.size(), 100u);
+        // The array is sized once for the whole page
+        EXPECT_EQ(direct.m_allocations, 1u);
+    }
+    EXPECT_EQ(direct.m_live, 0u);
+
+    // Pages kept in one arena share its growing upstream chunks
+    CountingResource upstream;
+    {
+        std::pmr::monotonic_buffer_resource arena(&upstream);
+        vector<Fdly::Entries> pages;
+        for (int i = 0; i < 20; i++) {
+            pages.push_back(m_fdly->GetEntries("All", false, 100, false, "", 0, Fdly::ContentFormat::HTML, &arena));
+        }
+        EXPECT_LT(upstream.m_allocations, pages.size());
+    }
+    EXPECT_EQ(upstream.m_live, 0u);
+}
+
+#else
+
+TEST(MemoryResourceTests, RequiresCpp17)
+{
+    GTEST_SKIP() << "Memory resources need C++17, configure with -DCMAKE_CXX_STANDARD=17";
+}
+
+#endif
@@ -0,0 +1,285 @@
+#include "fdly_opml.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
+
+using namespace std;
+
+static vector<OPML::Outline> readAll(const string& document)
+{
+    istringstream in(document);
+    OPML::Reader reader(in);
+    vector<OPML::Outline> outlines;
+    OPML::Outline outline;
+    while (reader.Next(outline)) {
+        outlines.push_back(outline);
+    }
+    return outlines;
+}
+
+/**
+ * Stream buffer that fails once the given number of characters were read.
+ */
+class FailingBuffer : public streambuf {
+    public:
+        FailingBuffer(const string& data, size_t failAfter) :
+            m_data(data.substr(0, failAfter))
+        {
+            setg(&m_data[0], &m_data[0], &m_data[0] + m_data.size());
+        }
+
+    protected:
+        int_type underflow() override
+        {
+            throw runtime_error("read failed");
+        }
+
+    private:
+        string m_data;
+};
+
+TEST(OPMLTests, NestedOutlines)
+{
+    auto outlines = readAll(
+        "<?xml version=\"1.0\"?>\n"
+        "<opml version=\"1.0\"><head><title>t</title></head><body>\n"
+        "  <outline text=\"tech\">\n"
+        "    <outline title=\"A\" xmlUrl=\"http://a/rss\" htmlUrl=\"http://a\"/>\n"
+        "    <outline text=\"linux\">\n"
+        "      <outline text=\"B\" xmlUrl=\"http://b/rss\"></outline>\n"
+        "    </outline>\n"
+        "    <outline text=\"C\" xmlUrl=\"http://c/rss\"/>\n"
+        "  </outline>\n"
+        "  <outline text=\"empty\"/>\n"
+        "  <outline text=\"D\" xmlUrl=\"http://d/rss\"/>\n"
+        "</body></opml>\n");
+
+    ASSERT_EQ(outlines.size(), 4u);
+
+    EXPECT_EQ(outlines[0].Title, "A");
+    EXPECT_EQ(outlines[0].HtmlUrl, "http://a");
+    EXPECT_EQ(outlines[0].CategoryLabels, vector<string>({"tech"}));
+
+    EXPECT_EQ(outlines[1].Title, "B");
+    EXPECT_EQ(outlines[1].CategoryLabels, vector<string>({"tech", "linux"}));
+
+    // Back in the outer category once the inner one and B are closed
+    EXPECT_EQ(outlines[2].XmlUrl, "http://c/rss");
+    EXPECT_EQ(outlines[2].CategoryLabels, vector<string>({"tech"}));
+
+    // The self-closing category does not apply to what follows
+    EXPECT_EQ(outlines[3].XmlUrl, "http://d/rss");
+    EXPECT_TRUE(outlines[3].CategoryLabels.empty());
+}
+
+TEST(OPMLTests, Entities)
+{
+    auto outlines = readAll(
+        "<outline text='Q&amp;A &lt;daily&gt; &quot;x&quot; &apos;y&apos;' xmlUrl=\"http://a/?a=1&amp;b=2\"/>"
+        "<outline text=\"caf&#233; &#x2603; &#x1F600; &unknown; &amp\" xmlUrl=\"http://b\"/>"
+        "<outline text=\"&#0;&#xD800;&#x110000;\" xmlUrl=\"http://c\"/>");
+
+    ASSERT_EQ(outlines.size(), 3u);
+    EXPECT_EQ(outlines[0].Title, "Q&A <daily> \"x\" 'y'");
+    EXPECT_EQ(outlines[0].XmlUrl, "http://a/?a=1&b=2");
+    EXPECT_EQ(outlines[1].Title, "caf\xC3\xA9 \xE2\x98\x83 \xF0\x9F\x98\x80 &unknown; &amp");
+    EXPECT_EQ(outlines[2].Title, "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD");
+}
+
+TEST(OPMLTests, SkipsCommentsAndMarkup)
+{
+    auto outlines = readAll(
+        "<!DOCTYPE opml>"
+        "<!-- <outline text=\"commented\" xmlUrl=\"http://x\"/> -->"
+        "<![CDATA[ <outline text=\"cdata\" xmlUrl=\"http://y\"/> ]]>"
+        "<?pi <outline xmlUrl=\"http://z\"/> ?>"
+        "<body><outline   text = \"A\"\n\txmlUrl = \"http://a\" / ></body>");
+
+    ASSERT_EQ(outlines.size(), 1u);
+    EXPECT_EQ(outlines[0].Title, "A");
+    EXPECT_EQ(outlines[0].XmlUrl, "http://a");
+}
+
+TEST(OPMLTests, MalformedInput)
+{
+    // Stray closing tags, unquoted values and a truncated document
+    auto outlines = readAll(
+        "</outline></body>"
+        "<outline text=A xmlUrl=http://a>"
+        "<outline text=\"B\" xmlUrl=\"http://b\" checked>"
+        "</outline></outline></outline>"
+        "<outline text=\"C\" xmlUrl=\"http://c");
+
+    ASSERT_EQ(outlines.size(), 3u);
+    EXPECT_EQ(outlines[0].Title, "A");
+    EXPECT_EQ(outlines[0].XmlUrl, "http://a");
+    EXPECT_EQ(outlines[1].XmlUrl, "http://b");
+    EXPECT_TRUE(outlines[1].CategoryLabels.empty());
+    EXPECT_EQ(outlines[2].XmlUrl, "http://c");
+
+    EXPECT_TRUE(readAll("").empty());
+    EXPECT_TRUE(readAll("<").empty());
+    EXPECT_TRUE(readAll("<outline").empty());
+    EXPECT_TRUE(readAll("<!-- never closed <outline xmlUrl=\"http://a\"/>").empty());
+}
+
+TEST(OPMLTests, ExportReadsBack)
+{
+    Fdly::Feed a {"A & co", "http://a"};
+    a.ID = "feed/http://a/rss";
+    a.Categories.append(Fdly::Category {"tech", "user/u/category/tech"});
+    Fdly::Feed b {"B", "http://b"};
+    b.ID = "feed/http://b/rss";
+
+    Fdly::Feeds feeds;
+    feeds.push_back(a);
+    feeds.push_back(b);
+
+    ostringstream out;
+    OPML::Export(feeds, out);
+    auto outlines = readAll(out.str());
+
+    ASSERT_EQ(outlines.size(), 2u);
+    EXPECT_EQ(outlines[0].Title, "A & co");
+    EXPECT_EQ(outlines[0].XmlUrl, "http://a/rss");
+    EXPECT_EQ(outlines[0].CategoryLabels, vector<string>({"tech"}));
+    EXPECT_EQ(outlines[1].XmlUrl, "http://b/rss");
+    EXPECT_TRUE(outlines[1].CategoryLabels.empty());
+}
+
+TEST(OPMLTests, ImportJoinsWorkersWhenReadingFails)
+{
+    atomic<int> subscribed(0);
+    Fdly::User user {"u", "token"};
+    Fdly::Options options;
+    options.Transport = [&] (const char*, const string&, const cpr::Header&, const string&) {
+        subscribed++;
+        cpr::Response r;
+        r.status_code = 200;
+        return r;
+    };
+    Fdly fdly(user, options);
+
+    string document;
+    for (int i = 0; i < 50; i++) {
+        document += "<outline text=\"F\" xmlUrl=\"http://f/" + to_string(i) + "\"/>";
+    }
+
+    FailingBuffer buffer(document, document.size() / 2);
+    istream in(&buffer);
+    in.exceptions(ios::badbit);
+
+    EXPECT_THROW(OPML::Import(fdly, in, 4), runtime_error);
+    EXPECT_GT(subscribed.load(), 0);
+
+    istringstream whole(document);
+    auto results = OPML::Import(fdly, whole, 4);
+    ASSERT_EQ(results.size(), 50u);
+    EXPECT_EQ(results[49].Feed.Url, "http://f/49");
+    for (const auto& result : results) {
+        EXPECT_TRUE(result.Succeeded) << result.Error;
+    }
+}
+
+/**
+ * Connection recording the body of every subscription request.
+ */
+class OPMLImportTests : public testing::Test {
+    public:
+        OPMLImportTests() :
+            m_user {"u", "token"}
+        {
+            Fdly::Options options;
+            options.Transport = [this] (const char*, const string&, const cpr::Header&, const string& body) {
+                {
+                    lock_guard<mutex> lock(m_mutex);
+                    m_posts.push_back(nlohmann::json::parse(body));
+                }
+                cpr::Response r;
+                r.status_code = 200;
+                return r;
+            };
+            m_fdly.reset(new Fdly(m_user, options));
+        }
+
+        static vector<string> Labels(const nlohmann::json& post)
+        {
+            vector<string> labels;
+            for (const auto& ctg : post["categories"]) {
+                labels.push_back(ctg["label"]);
+            }
+            sort(labels.begin(), labels.end());
+            return labels;
+        }
+
+        Fdly::User m_user;
+        unique_ptr<Fdly> m_fdly;
+        mutex m_mutex;
+        vector<nlohmann::json> m_posts;
+};
+
+TEST_F(OPMLImportTests, FeedInTwoCategoriesRoundTrips)
+{
+    Fdly::Feed a {"A", "http://a"};
+    a.ID = "feed/http://a/rss";
+    a.Categories.append(Fdly::Category {"tech", "user/u/category/tech"});
+    a.Categories.append(Fdly::Category {"news", "user/u/category/news"});
+    Fdly::Feeds feeds;
+    feeds.push_back(a);
+
+    ostringstream out;
+    OPML::Export(feeds, out);
+    istringstream in(out.str());
+    auto results = OPML::Import(*m_fdly, in, 4);
+
+    ASSERT_EQ(results.size(), 1u);
+    EXPECT_TRUE(results[0].Succeeded) << results[0].Error;
+    ASSERT_EQ(m_posts.size(), 1u);
+    EXPECT_EQ(m_posts[0]["id"], "feed/http://a/rss");
+    EXPECT_EQ(Labels(m_posts[0]), vector<string>({"news", "tech"}));
+}
+
+TEST_F(OPMLImportTests, DuplicateOutlinesAreOneFeed)
+{
+    // As written by exporters listing a feed under each of its categories
+    string document =
+        "<outline text=\"tech\"><outline text=\"A\" xmlUrl=\"http://a/rss\"/></outline>";
+    for (int i = 0; i < 20; i++) {
+        document += "<outline text=\"F\" xmlUrl=\"http://f/" + to_string(i) + "\"/>";
+    }
+    document += "<outline text=\"news\"><outline text=\"A\" xmlUrl=\"http://a/rss\"/></outline>"
+                "<outline text=\"tech\"><outline text=\"A\" xmlUrl=\"http://a/rss\"/></outline>";
+
+    istringstream in(document);
+    auto results = OPML::Import(*m_fdly, in, 2);
+
+    ASSERT_EQ(results.size(), 21u);
+    EXPECT_EQ(results[0].Feed.Url, "http://a/rss");
+    EXPECT_TRUE(results[0].Succeeded) << results[0].Error;
+
+    // The feed is sent again if it was already sent without every category,
+    // and its last request carries all of them
+    vector<nlohmann::json> posts;
+    for (const auto& post : m_posts) {
+        if (post["id"] == "feed/http://a/rss") {
+            posts.push_back(post);
+        }
+    }
+    ASSERT_GE(posts.size(), 1u);
+    ASSERT_LE(posts.size(), 2u);
+    EXPECT_EQ(Labels(posts.back()), vector<string>({"news", "tech"}));
+}
+
+TEST(OPMLTests, CategoryAttribute)
+{
+    auto outlines = readAll(
+        "<outline text=\"tech\">"
+        "<outline text=\"A\" xmlUrl=\"http://a\" category=\"/news, /tech,,/local/weather\"/>"
+        "</outline>");
+
+    ASSERT_EQ(outlines.size(), 1u);
+    EXPECT_EQ(outlines[0].CategoryLabels, vector<string>({"tech", "news", "local/weather"}));
+}
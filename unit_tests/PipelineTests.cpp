@@ -0,0 +1,102 @@
+#include "fdly_pipeline.hpp"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <ctime>
+#include <map>
+
+using namespace std;
+
+/**
+ * Connection serving pages "<stream>-<n>" for every stream, with a
+ * continuation on all but the last of them.
+ */
+class PipelineTests : public testing::Test {
+    public:
+        PipelineTests() :
+            m_user {"u", "token"},
+            m_pages(3),
+            m_latency(0)
+        {
+            Fdly::Options options;
+            options.Transport = [this] (const char*, const string& url, const cpr::Header&, const string&) {
+                this_thread::sleep_for(chrono::milliseconds(m_latency));
+
+                auto begin = url.find("streamId=") + 9;
+                string stream = url.substr(begin, url.find('&', begin) - begin);
+                int page = 0;
+                auto continuation = url.find("continuation=");
+                if (continuation != string::npos) {
+                    page = atoi(url.c_str() + continuation + 13);
+                }
+
+                string body = "{\"items\":[{\"id\":\"" + stream + "-" + to_string(page) + "\",\"title\":\"t\",\"originId\":\"o\"}]";
+                if (page + 1 < m_pages) {
+                    body += ",\"continuation\":\"" + to_string(page + 1) + "\"";
+                }
+                body += "}";
+
+                cpr::Response r;
+                r.status_code = 200;
+                r.text = body;
+                return r;
+            };
+            m_fdly.reset(new Fdly(m_user, options));
+        }
+
+        Fdly::User m_user;
+        unique_ptr<Fdly> m_fdly;
+        int m_pages;
+        int m_latency;
+};
+
+TEST_F(PipelineTests, PagesThroughEveryStream)
+{
+    EntriesPipeline pipeline(*m_fdly, 2);
+    map<string, vector<string>> seen;
+    pipeline.Run({"a", "b", "c"}, [&] (const string& stream, Fdly::Entries& entries) {
+        for (const auto& entry : entries) {
+            seen[stream].push_back(entry.ID);
+        }
+    });
+
+    ASSERT_EQ(seen.size(), 3u);
+    EXPECT_EQ(seen["a"], vector<string>({"a-0", "a-1", "a-2"}));
+    EXPECT_EQ(seen["c"], vector<string>({"c-0", "c-1", "c-2"}));
+
+    pipeline.SetPaging(false, 20, true, 2);
+    seen.clear();
+    pipeline.Run({"a"}, [&] (const string& stream, Fdly::Entries& entries) {
+        seen[stream].push_back((*entries.begin()).ID);
+    });
+    EXPECT_EQ(seen["a"], vector<string>({"a-0", "a-1"}));
+}
+
+TEST_F(PipelineTests, ConsumerErrorIsRethrown)
+{
+    m_pages = 1000;
+    EntriesPipeline pipeline(*m_fdly, 1);
+    int consumed = 0;
+    EXPECT_THROW(pipeline.Run({"a", "b"}, [&] (const string&, Fdly::Entries&) {
+        if (++consumed == 5) {
+            throw runtime_error("consumer failed");
+        }
+    }), runtime_error);
+    EXPECT_EQ(consumed, 5);
+}
+
+TEST_F(PipelineTests, WaitingStagesSleep)
+{
+    m_latency = 100;
+    m_pages = 8;
+    EntriesPipeline pipeline(*m_fdly);
+
+    clock_t cpu = clock();
+    auto wall = chrono::steady_clock::now();
+    pipeline.Run({"a"}, [] (const string&, Fdly::Entries&) {});
+    double cpuSeconds = double(clock() - cpu) / CLOCKS_PER_SEC;
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - wall).count();
+
+    // The decoder and consumer wait on the fetcher for most of the run
+    EXPECT_GT(wallSeconds, 0.7);
+    EXPECT_LT(cpuSeconds, wallSeconds / 4);
+}
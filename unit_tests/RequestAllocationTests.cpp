@@ -0,0 +1,123 @@
+#include "fdly.hpp"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+/*
+ * Global operator new and delete are replaced to count the allocations made
+ * by the calling thread while counting is on. GCC 11 and later flag the
+ * malloc/free pairs of the replacements once inlined, a false positive.
+ */
+#if defined(__GNUC__) && __GNUC__ >= 11 && not defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+static thread_local bool t_counting = false;
+static thread_local unsigned long t_allocations = 0;
+
+void* operator new(size_t size)
+{
+    if (t_counting) {
+        t_allocations++;
+    }
+
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+template<class F>
+static unsigned long countAllocations(F&& f)
+{
+    t_allocations = 0;
+    t_counting = true;
+    f();
+    t_counting = false;
+    return t_allocations;
+}
+
+TEST(RequestAllocationTests, EntriesUrl)
+{
+    Fdly::User user {"00000000-1111-2222-3333-444444444444", "token"};
+    Fdly connection(user);
+
+    EXPECT_EQ(connection.EntriesUrl("All"),
+              string(Fdly::FeedlyUrl) + "/v3/streams/contents?ranked=newest&unreadOnly=true&count=20"
+              "&streamId=user%2F00000000-1111-2222-3333-444444444444%2Fcategory%2Fglobal.all");
+
+    EXPECT_EQ(connection.EntriesUrl("user/u/category/tech", true, 100, false, "15f6ad8e3a1:2c1e:3d5b", 1500000000000),
+              string(Fdly::FeedlyUrl) + "/v3/streams/contents?ranked=oldest&unreadOnly=false&count=100"
+              "&continuation=15f6ad8e3a1%3A2c1e%3A3d5b&newerThan=1500000000000"
+              "&streamId=user%2Fu%2Fcategory%2Ftech");
+}
+
+TEST(RequestAllocationTests, EntriesUrlIsAllocationFree)
+{
+    Fdly::User user {"00000000-1111-2222-3333-444444444444", "token"};
+    Fdly connection(user);
+    const string categoryId = "user/00000000-1111-2222-3333-444444444444/category/tech";
+    const string continuation = "15f6ad8e3a1:2c1e:3d5b";
+
+    // Grow the per thread buffer to size
+    connection.EntriesUrl(categoryId, true, 1000, false, continuation, 1500000000000);
+
+    EXPECT_EQ(countAllocations([&] {
+        connection.EntriesUrl("All");
+        connection.EntriesUrl("Uncategorized", true, 100);
+        connection.EntriesUrl("Saved", false, 20, false, continuation);
+        connection.EntriesUrl(categoryId, true, 1000, false, continuation, 1500000000000);
+    }), 0u);
+}
+
+TEST(RequestAllocationTests, GetEntriesIsAllocationFreeUntilSent)
+{
+    Fdly::User user {"00000000-1111-2222-3333-444444444444", "token"};
+    Fdly::Options options;
+    unsigned long beforeSending = 0;
+    options.Transport = [&] (const char*, const string&, const cpr::Header&, const string&) {
+        beforeSending = t_allocations;
+        bool counting = t_counting;
+        t_counting = false;
+
+        cpr::Response r;
+        r.status_code = 200;
+        r.text = R"({"items":[{"id":"e1","title":"t","originId":"o"}]})";
+
+        t_counting = counting;
+        return r;
+    };
+    Fdly connection(user, options);
+    connection.SetEntriesCacheBudget(1 << 20);
+    const string categoryId = "user/00000000-1111-2222-3333-444444444444/category/tech";
+    const string continuation = "15f6ad8e3a1:2c1e:3d5b";
+
+    // Grow the per thread buffers to size
+    connection.GetEntries(categoryId, true, 1000, false, continuation, 1500000000000, Fdly::ContentFormat::TEXT);
+
+    // Neither the cache lookup nor the request coalescing allocate
+    countAllocations([&] {
+        connection.GetEntries(categoryId, false, 100, false, continuation);
+    });
+    EXPECT_EQ(beforeSending, 0u);
+
+    beforeSending = 1;
+    countAllocations([&] {
+        connection.GetEntries("All");
+    });
+    EXPECT_EQ(beforeSending, 0u);
+    EXPECT_EQ(connection.GetEntriesCacheStats().Pages, 3u);
+}
@@ -0,0 +1,187 @@
+#include "fdly_scheduler.hpp"
+#include <gtest/gtest.h>
+
+using namespace std;
+
+static const long long g_minute = 60 * 1000;
+static const long long g_hour = 60 * g_minute;
+
+/**
+ * Connection whose feeds return the entries in m_entries that are newer
+ * than the requested time, as (published, crawled) pairs.
+ */
+class SchedulerTests : public testing::Test {
+    public:
+        SchedulerTests() :
+            m_user {"u", "token"},
+            m_polls(0)
+        {
+            Fdly::Options options;
+            options.Transport = [this] (const char*, const string& url, const cpr::Header&, const string&) {
+                m_polls++;
+                if (not m_failing.empty() && url.find("streamId=" + m_failing) != string::npos) {
+                    throw runtime_error("connection reset");
+                }
+                long long newerThan = 0;
+                auto begin = url.find("newerThan=");
+                if (begin != string::npos) {
+                    newerThan = atoll(url.c_str() + begin + 10);
+                }
+
+                string body = "{\"items\":[";
+                int n = 0;
+                for (const auto& entry : m_entries) {
+                    if (max(entry.first, entry.second) <= newerThan) {
+                        continue;
+                    }
+                    body += n++ ? "," : "";
+                    body += "{\"id\":\"e" + to_string(n) + "\",\"title\":\"t\",\"originId\":\"o\"";
+                    if (entry.first > 0) {
+                        body += ",\"published\":" + to_string(entry.first);
+                    }
+                    if (entry.second > 0) {
+                        body += ",\"crawled\":" + to_string(entry.second);
+                    }
+                    body += "}";
+                }
+                body += "]}";
+
+                cpr::Response r;
+                r.status_code = 200;
+                r.text = body;
+                return r;
+            };
+            m_fdly.reset(new Fdly(m_user, options));
+        }
+
+        size_t Poll(PollScheduler& scheduler, long long nowMs)
+        {
+            return scheduler.Poll(*m_fdly, [] (const string&, Fdly::Entries&) {}, 100, nowMs);
+        }
+
+        Fdly::User m_user;
+        unique_ptr<Fdly> m_fdly;
+        vector<pair<long long, long long>> m_entries;
+        int m_polls;
+        string m_failing;
+};
+
+TEST_F(SchedulerTests, PollRecordsWhenEntriesWerePublished)
+{
+    const long long start = 1000 * g_hour;
+    PollScheduler scheduler(60);
+    scheduler.Track("feed/a", start, start);
+
+    // Published an hour after the last update, but only seen 5 hours later
+    m_entries = {{start + g_hour, start + g_hour + g_minute}, {start + g_hour / 2, 0}};
+    EXPECT_EQ(Poll(scheduler, start + 5 * g_hour), 1u);
+    EXPECT_EQ(scheduler.EstimatedIntervalMs("feed/a"), g_hour);
+
+    // Nothing new: the estimate is left alone
+    EXPECT_EQ(Poll(scheduler, start + 8 * g_hour), 1u);
+    EXPECT_EQ(scheduler.EstimatedIntervalMs("feed/a"), g_hour);
+}
+
+TEST_F(SchedulerTests, PollFallsBackToCrawledAndIgnoresTheFuture)
+{
+    const long long start = 1000 * g_hour;
+    PollScheduler scheduler(60);
+    scheduler.Track("feed/a", start, start);
+
+    m_entries = {{0, start + 2 * g_hour}};
+    Poll(scheduler, start + 3 * g_hour);
+    EXPECT_EQ(scheduler.EstimatedIntervalMs("feed/a"), 2 * g_hour);
+
+    // Dated a day ahead: counts as updated at poll time
+    m_entries = {{start + 24 * g_hour, start + 4 * g_hour}};
+    Poll(scheduler, start + 6 * g_hour);
+    EXPECT_EQ(scheduler.EstimatedIntervalMs("feed/a"),
+            static_cast<long long>(0.3 * 4 * g_hour + 0.7 * 2 * g_hour));
+}
+
+TEST_F(SchedulerTests, EstimateFollowsPublicationNotPolling)
+{
+    const long long start = 1000 * g_hour;
+    PollScheduler scheduler(600, g_minute);
+    scheduler.Track("feed/a", start, start);
+
+    // Published every 3 hours, polled whenever due for two days
+    for (long long now = start; now <= start + 48 * g_hour; now += 7 * g_minute) {
+        if (now > start && (now - start) % (3 * g_hour) < 7 * g_minute) {
+            long long published = now - (now - start) % (3 * g_hour);
+            m_entries.push_back({published, published});
+        }
+        Poll(scheduler, now);
+    }
+
+    EXPECT_EQ(scheduler.EstimatedIntervalMs("feed/a"), 3 * g_hour);
+    // Polled a few times per interval, not every 7 minutes
+    EXPECT_LT(m_polls, 48);
+}
+
+TEST(PollSchedulerTests, Budget)
+{
+    const long long start = 1000 * g_hour;
+    PollScheduler scheduler(2);
+    scheduler.Track("feed/a", 0, start);
+    scheduler.Track("feed/b", 0, start);
+    scheduler.Track("feed/c", 0, start);
+
+    EXPECT_EQ(scheduler.Due(start).size(), 2u);
+    EXPECT_TRUE(scheduler.Due(start + 10 * 1000).empty());
+    // One more poll every 30 seconds
+    EXPECT_EQ(scheduler.Due(start + 30 * 1000).size(), 1u);
+    EXPECT_TRUE(scheduler.Due(start + 40 * 1000).empty());
+}
+
+TEST(PollSchedulerTests, IntervalBounds)
+{
+    const long long start = 1000 * g_hour;
+    PollScheduler scheduler(60, 10 * g_minute, g_hour);
+
+    // Unknown feeds are polled at the shortest interval
+    scheduler.Track("feed/a", 0, start);
+    EXPECT_EQ(scheduler.Due(start), vector<string>({"feed/a"}));
+    EXPECT_EQ(scheduler.NextDueMs(), start + 10 * g_minute);
+
+    // A fast feed is held to the shortest interval
+    scheduler.Observe("feed/a", start - g_minute, start);
+    scheduler.Observe("feed/a", start, start);
+    EXPECT_EQ(scheduler.EstimatedIntervalMs("feed/a"), g_minute);
+    EXPECT_EQ(scheduler.Due(start + 10 * g_minute), vector<string>({"feed/a"}));
+    EXPECT_EQ(scheduler.NextDueMs(), start + 20 * g_minute);
+
+    // A dormant one to the longest
+    scheduler.Untrack("feed/a");
+    scheduler.Track("feed/b", start - 100 * g_hour, start);
+    EXPECT_EQ(scheduler.Due(start), vector<string>({"feed/b"}));
+    EXPECT_EQ(scheduler.NextDueMs(), start + g_hour);
+}
+
+TEST_F(SchedulerTests, AFailingFeedStaysDue)
+{
+    const long long start = 1000 * g_hour;
+    PollScheduler scheduler(60);
+    for (const char* id : {"feed/a", "feed/b", "feed/c"}) {
+        scheduler.Track(id, 0, start);
+    }
+
+    m_failing = "feed%2Fb";
+    vector<string> polled;
+    auto collect = [&polled] (const string& id, Fdly::Entries&) { polled.push_back(id); };
+    EXPECT_THROW(scheduler.Poll(*m_fdly, collect, 100, start), runtime_error);
+    EXPECT_EQ(m_polls, 3);
+    EXPECT_EQ(polled, vector<string>({"feed/a", "feed/c"}));
+    EXPECT_EQ(scheduler.Due(start + 1000), vector<string>({"feed/b"}));
+
+    // Same for a failing callback
+    scheduler.Track("feed/d", 0, start);
+    auto failing = [] (const string& id, Fdly::Entries&) {
+        if (id == "feed/d") {
+            throw runtime_error("callback failed");
+        }
+    };
+    m_failing.clear();
+    EXPECT_THROW(scheduler.Poll(*m_fdly, failing, 100, start + 2000), runtime_error);
+    EXPECT_EQ(scheduler.Due(start + 3000), vector<string>({"feed/d"}));
+}
@@ -0,0 +1,63 @@
+#include "fdly.hpp"
+#include <gtest/gtest.h>
+
+using namespace std;
+
+TEST(StringPoolTests, SharesOneCopyPerValue)
+{
+    Fdly::StringPool pool;
+    auto a = pool.Intern("http://a");
+    auto b = pool.Intern(string("http://a"));
+
+    EXPECT_EQ(a.c_str(), b.c_str());
+    EXPECT_EQ(pool.size(), 1u);
+    EXPECT_EQ(pool.Purge(), 0u);
+}
+
+TEST(StringPoolTests, DropsUnusedStringsAsItGrows)
+{
+    Fdly::StringPool pool(8);
+    auto kept = pool.Intern("kept");
+
+    for (int i = 0; i < 1000; i++) {
+        pool.Intern("dropped " + to_string(i));
+        EXPECT_LE(pool.size(), 9u);
+    }
+
+    // Still interned after every purge
+    EXPECT_EQ(pool.Intern("kept").c_str(), kept.c_str());
+
+    // Values in use make the pool grow instead of purging in vain
+    vector<Fdly::InternedString> used;
+    for (int i = 0; i < 100; i++) {
+        used.push_back(pool.Intern("used " + to_string(i)));
+    }
+    EXPECT_GE(pool.size(), 101u);
+    EXPECT_LE(pool.size(), 2 * 101u + 1);
+
+    used.clear();
+    EXPECT_GE(pool.Purge(), 100u);
+    EXPECT_EQ(pool.size(), 1u);
+}
+
+TEST(StringPoolTests, InternedStringsBehaveLikeStrings)
+{
+    Fdly::StringPool pool;
+    Fdly::Category category {"tech", "user/u/category/tech"};
+    category.Label = pool.Intern("tech");
+
+    const string& label = category.Label;
+    EXPECT_EQ(label, "tech");
+    EXPECT_TRUE("tech" == category.Label);
+    EXPECT_TRUE(string("tech") == category.Label);
+    EXPECT_EQ("#" + category.Label + "/" + category.ID, "#tech/user/u/category/tech");
+    EXPECT_EQ(string(category.Label.begin(), category.Label.end()), "tech");
+
+    string copy = category.Label;
+    copy += "!";
+    EXPECT_EQ(copy, "tech!");
+    EXPECT_EQ(category.Label, "tech");
+
+    category.Label = copy;
+    EXPECT_EQ(category.Label, "tech!");
+}
@@ -0,0 +1,175 @@
+#include "fdly.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <iterator>
+#include <functional>
+
+using namespace std;
+
+static Fdly::Feed MakeFeed(const string& id, const vector<string>& categories)
+{
+    Fdly::Feed feed;
+    feed.ID = id;
+    feed.Title = id;
+    for (const auto& ctg : categories) {
+        feed.Categories.append(Fdly::Category {ctg, "user/u/category/" + ctg});
+    }
+    return feed;
+}
+
+static vector<string> InCategory(const Fdly::FeedIndex& index, const string& category)
+{
+    vector<string> ids;
+    index.ForEachInCategory("user/u/category/" + category, [&ids] (const Fdly::Feed& feed) {
+        ids.push_back(feed.ID);
+    });
+    sort(ids.begin(), ids.end());
+    return ids;
+}
+
+TEST(SubscriptionsIndexTests, AddFindAndForEachInCategory)
+{
+    Fdly::FeedIndex index;
+    EXPECT_TRUE(index.empty());
+    EXPECT_EQ(index.Find("feed/a"), nullptr);
+
+    index.Add(MakeFeed("feed/a", {"tech", "news"}));
+    index.Add(MakeFeed("feed/b", {"tech"}));
+    index.Add(MakeFeed("feed/c", {}));
+
+    EXPECT_EQ(index.size(), 3u);
+    ASSERT_NE(index.Find("feed/c"), nullptr);
+    EXPECT_EQ(index.Find("feed/c")->Title, "feed/c");
+    EXPECT_EQ(InCategory(index, "tech"), (vector<string> {"feed/a", "feed/b"}));
+    EXPECT_EQ(InCategory(index, "news"), (vector<string> {"feed/a"}));
+    EXPECT_TRUE(InCategory(index, "design").empty());
+    EXPECT_EQ(index.InCategory("user/u/category/tech").size(), 2u);
+}
+
+TEST(SubscriptionsIndexTests, ReplacingAFeedUnlinksItsOldCategories)
+{
+    Fdly::FeedIndex index;
+    index.Add(MakeFeed("feed/a", {"tech", "news"}));
+    auto old = index.Find("feed/a");
+
+    index.Add(MakeFeed("feed/a", {"news", "design"}));
+    EXPECT_EQ(index.size(), 1u);
+    EXPECT_TRUE(InCategory(index, "tech").empty());
+    EXPECT_EQ(InCategory(index, "news"), (vector<string> {"feed/a"}));
+    EXPECT_EQ(InCategory(index, "design"), (vector<string> {"feed/a"}));
+
+    // Readers keep the feed they were handed
+    EXPECT_EQ(distance(old->Categories.begin(), old->Categories.end()), 2);
+    EXPECT_NE(index.Find("feed/a"), old);
+}
+
+TEST(SubscriptionsIndexTests, Remove)
+{
+    Fdly::FeedIndex index;
+    index.Add(MakeFeed("feed/a", {"tech"}));
+    index.Add(MakeFeed("feed/b", {"tech"}));
+
+    EXPECT_TRUE(index.Remove("feed/a"));
+    EXPECT_FALSE(index.Remove("feed/a"));
+    EXPECT_EQ(index.Find("feed/a"), nullptr);
+    EXPECT_EQ(InCategory(index, "tech"), (vector<string> {"feed/b"}));
+
+    EXPECT_TRUE(index.Remove("feed/b"));
+    EXPECT_TRUE(InCategory(index, "tech").empty());
+    EXPECT_TRUE(index.empty());
+}
+
+TEST(SubscriptionsIndexTests, AssignKeepsChangesMadeSinceTheFetch)
+{
+    Fdly::FeedIndex index;
+    index.Add(MakeFeed("feed/a", {"tech"}));
+    index.Add(MakeFeed("feed/b", {"tech"}));
+
+    // The list is fetched while feed/c is added and feed/b removed
+    auto since = index.BeginUpdate();
+    index.Add(MakeFeed("feed/c", {"tech"}));
+    index.Remove("feed/b");
+    Fdly::Feeds fetched;
+    fetched.push_back(MakeFeed("feed/a", {"tech"}));
+    fetched.push_back(MakeFeed("feed/b", {"tech"}));
+    index.Assign(fetched, since);
+
+    EXPECT_EQ(InCategory(index, "tech"), (vector<string> {"feed/a", "feed/c"}));
+
+    // Once no update is in progress, a new list replaces everything
+    Fdly::Feeds current;
+    current.push_back(MakeFeed("feed/d", {"news"}));
+    index.Assign(current);
+    EXPECT_EQ(index.size(), 1u);
+    EXPECT_TRUE(InCategory(index, "tech").empty());
+}
+
+TEST(SubscriptionsIndexTests, AnOlderListIsDropped)
+{
+    Fdly::FeedIndex index;
+    auto older = index.BeginUpdate();
+    index.Add(MakeFeed("feed/a", {"tech"}));
+    auto newer = index.BeginUpdate();
+
+    Fdly::Feeds withA;
+    withA.push_back(MakeFeed("feed/a", {"tech"}));
+    index.Assign(withA, newer);
+    index.Assign(Fdly::Feeds(), older);
+    EXPECT_NE(index.Find("feed/a"), nullptr);
+}
+
+/**
+ * Connection serving a list of subscriptions, running m_duringFetch while
+ * the list is being fetched.
+ */
+class SubscriptionsIndexConnectionTests : public testing::Test {
+    public:
+        SubscriptionsIndexConnectionTests() :
+            m_user {"u", "token"}
+        {
+            Fdly::Options options;
+            options.Transport = [this] (const char* method, const string&, const cpr::Header&, const string&) {
+                cpr::Response r;
+                r.status_code = 200;
+                if (string(method) == "GET") {
+                    if (m_duringFetch) {
+                        auto duringFetch = move(m_duringFetch);
+                        m_duringFetch = nullptr;
+                        duringFetch();
+                    }
+                    r.text = R"([{"id":"feed/a","title":"a","website":"w","visualUrl":"v","categories":[{"label":"tech","id":"user/u/category/tech"}]}])";
+                }
+                return r;
+            };
+            m_fdly.reset(new Fdly(m_user, options));
+        }
+
+        Fdly::User m_user;
+        unique_ptr<Fdly> m_fdly;
+        function<void()> m_duringFetch;
+};
+
+TEST_F(SubscriptionsIndexConnectionTests, AddingDuringAFetchIsNotLost)
+{
+    m_duringFetch = [this] {
+        Fdly::Feed feed;
+        feed.Url = "http://example.com/rss";
+        feed.Categories.append(Fdly::Category {"tech", "user/u/category/tech"});
+        m_fdly->AddSubscription(feed);
+    };
+    m_fdly->GetSubscriptions();
+
+    const auto& index = m_fdly->GetSubscriptionsIndex();
+    EXPECT_NE(index.Find("feed/a"), nullptr);
+    EXPECT_NE(index.Find("feed/http://example.com/rss"), nullptr);
+    EXPECT_EQ(index.InCategory("user/u/category/tech").size(), 2u);
+}
+
+TEST_F(SubscriptionsIndexConnectionTests, OnlyTheCoalescedCallBuildsTheIndex)
+{
+    EXPECT_EQ(m_fdly->GetSubscriptions(nullptr).size(), 1u);
+    EXPECT_TRUE(m_fdly->GetSubscriptionsIndex().empty());
+
+    m_fdly->GetSubscriptions();
+    EXPECT_EQ(m_fdly->GetSubscriptionsIndex().size(), 1u);
+}